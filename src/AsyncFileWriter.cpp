@@ -0,0 +1,143 @@
+#include "AsyncFileWriter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+AsyncFileWriter::AsyncFileWriter(size_t buffer_size, int num_buffers)
+    : buffer_size_(buffer_size), buffers_(num_buffers, 0) {
+  ASSERT(buffer_size > 0 && num_buffers >= 2, "Invalid writer buffers");
+  const size_t PAGE_SIZE = 4096;
+
+  for(char *&buffer : buffers_) {
+    void *memory = 0;
+    int error = posix_memalign(&memory, PAGE_SIZE, buffer_size_);
+    ASSERT(error == 0, "Could not allocate writer buffer");
+    buffer = static_cast<char *>(memory);
+  }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  if(file_descriptor_ >= 0) {close();}
+  for(char *buffer : buffers_) {free(buffer);}
+}
+
+bool AsyncFileWriter::open(const std::string &file_name) {
+  if(file_descriptor_ >= 0) {close();}
+
+  file_name_ = file_name;
+  if(file_name == "-") {
+    file_descriptor_ = STDOUT_FILENO;
+  } else {
+    file_descriptor_ = ::open(file_name.c_str(),
+                              O_CREAT | O_WRONLY | O_TRUNC | O_LARGEFILE, 0644);
+    if(file_descriptor_ < 0) {return false;}
+  }
+
+  size_ = 0;
+  current_buffer_ = 0;
+  current_size_ = 0;
+  pending_.clear();
+  free_buffers_.clear();
+  for(int i = buffers_.size() - 1; i > 0; --i) {free_buffers_.push_back(i);}
+  writing_ = false;
+  stop_ = false;
+  thread_ = std::thread(&AsyncFileWriter::writeLoop, this);
+  return true;
+}
+
+void AsyncFileWriter::close() {
+  ASSERT(file_descriptor_ >= 0, "AsyncFileWriter already closed");
+  drain();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  if(file_descriptor_ != STDOUT_FILENO) {::close(file_descriptor_);}
+  file_descriptor_ = -1;
+}
+
+void AsyncFileWriter::write(const void *data, size_t size) {
+  const char *ptr = static_cast<const char *>(data);
+  size_ += size;
+
+  while(size > 0) {
+    size_t copy_size = buffer_size_ - current_size_;
+    if(copy_size > size) {copy_size = size;}
+
+    memcpy(buffers_[current_buffer_] + current_size_, ptr, copy_size);
+    current_size_ += copy_size;
+    ptr += copy_size;
+    size -= copy_size;
+
+    if(current_size_ == buffer_size_) {submitBuffer();}
+  }
+}
+
+void AsyncFileWriter::writeAt(const void *data, size_t size, int64_t offset) {
+  drain();
+  const char *ptr = static_cast<const char *>(data);
+
+  while(size > 0) {
+    ssize_t b = pwrite(file_descriptor_, ptr, size, offset);
+    ASSERT(b > 0, "Could not write " << file_name_);
+    ptr += b;
+    offset += b;
+    size -= b;
+  }
+}
+
+void AsyncFileWriter::submitBuffer() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.push_back(std::make_pair(current_buffer_, current_size_));
+  cv_.notify_all();
+
+  cv_.wait(lock, [this] {return !free_buffers_.empty();});
+  current_buffer_ = free_buffers_.back();
+  free_buffers_.pop_back();
+  current_size_ = 0;
+}
+
+void AsyncFileWriter::drain() {
+  if(current_size_ > 0) {submitBuffer();}
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] {return pending_.empty() && !writing_;});
+}
+
+void AsyncFileWriter::writeLoop() {
+  while(true) {
+    std::pair<int, size_t> buffer;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] {return stop_ || !pending_.empty();});
+      if(pending_.empty()) {return;}
+      buffer = pending_.front();
+      pending_.pop_front();
+      writing_ = true;
+    }
+
+    const char *ptr = buffers_[buffer.first];
+    size_t size = buffer.second;
+
+    while(size > 0) {
+      ssize_t b = ::write(file_descriptor_, ptr, size);
+      ASSERT(b > 0, "Could not write " << file_name_);
+      ptr += b;
+      size -= b;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_buffers_.push_back(buffer.first);
+      writing_ = false;
+    }
+    cv_.notify_all();
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef _SVRG_ASYNCFILEWRITER_H_
+#define _SVRG_ASYNCFILEWRITER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes a file sequentially from a background thread. Appended bytes are
+// gathered into a ring of large page-aligned buffers; a full buffer is
+// written by the background thread while the caller fills the next one.
+// Appends of any size are supported.
+class AsyncFileWriter {
+ public:
+  AsyncFileWriter(size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                  int num_buffers = DEFAULT_NUM_BUFFERS);
+  ~AsyncFileWriter();
+
+  AsyncFileWriter(const AsyncFileWriter &) = delete;
+  AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+  // Creates (or truncates) the file. "-" writes to the standard output.
+  // Returns false if the file cannot be created.
+  bool open(const std::string &file_name);
+
+  // Writes the pending bytes and closes the file.
+  void close();
+
+  // Appends bytes at the end of the file.
+  void write(const void *data, size_t size);
+
+  // Overwrites bytes at the given offset (e.g. a header) after writing the
+  // pending bytes. The output must be a regular file.
+  void writeAt(const void *data, size_t size, int64_t offset);
+
+  // Number of bytes appended so far.
+  int64_t size() const {return size_;}
+
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 8 * 1024 * 1024;
+  static constexpr int DEFAULT_NUM_BUFFERS = 3;
+
+ private:
+  // Queues the current buffer for writing and waits for a free one.
+  void submitBuffer();
+
+  // Waits until all queued buffers are written.
+  void drain();
+
+  // Runs on the background thread.
+  void writeLoop();
+
+  size_t buffer_size_;
+  std::vector<char *> buffers_;
+
+  std::string file_name_;
+  int file_descriptor_ = -1;
+  int64_t size_ = 0;
+
+  // Buffer being filled by the caller and number of bytes in it.
+  int current_buffer_ = -1;
+  size_t current_size_ = 0;
+
+  // Buffers (and their sizes) waiting to be written, in file order.
+  std::deque<std::pair<int, size_t>> pending_;
+  std::vector<int> free_buffers_;
+  bool writing_ = false;
+  bool stop_ = false;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "BinaryDataWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool BinaryDataWriter::open() {
+  ASSERT(version_ == 1 || version_ == 2, "Invalid format version " << version_);
+  ASSERT(examples_per_block_ > 0 &&
+         (examples_per_block_ & (examples_per_block_ - 1)) == 0,
+         "Examples per block must be a power of 2");
+  ASSERT((flags_ & ~BIN_V2_ALL_FLAGS) == 0 && (version_ == 2 || flags_ == 0),
+         "Compression is only supported by version 2");
+  ASSERT(!((flags_ & BIN_V2_FLOAT16_VALUES) && (flags_ & BIN_V2_UINT8_VALUES)),
+         "Only one value encoding can be used");
+
+  if(!file_.open(file_name_)) {return false;}
+  is_open_ = true;
+
+  // The header is written when closing.
+  std::vector<char> header((version_ == 1) ?BIN_HEADER_SIZE :sizeof(BinV2Header));
+  file_.write(header.data(), header.size());
+  pending_.clear();
+  return true;
+}
+
+void BinaryDataWriter::close() {
+  ASSERT(is_open_, "BinaryDataWriter already closed");
+  flushBlock();
+
+  if(version_ == 1) {
+    SparseExample::Index num_features = max_feature_id_ + 1;
+    file_.writeAt(&num_examples_, sizeof(num_examples_), 0);
+    file_.writeAt(&num_features, sizeof(num_features), sizeof(num_examples_));
+  } else {
+    BinV2Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BIN_V2_MAGIC, sizeof(BIN_V2_MAGIC));
+    header.version = BIN_V2_VERSION;
+    header.flags = flags_;
+    header.num_examples = num_examples_;
+    header.num_nonzero = num_nonzero_;
+    header.num_features = max_feature_id_ + 1;
+    header.examples_per_block = examples_per_block_;
+    header.num_blocks = blocks_.size();
+    header.block_index_offset = file_.size();
+    header.block_index_checksum = binV2Checksum(
+        blocks_.data(), blocks_.size() * sizeof(BinV2BlockInfo));
+
+    file_.write(blocks_.data(), blocks_.size() * sizeof(BinV2BlockInfo));
+    file_.writeAt(&header, sizeof(header), 0);
+  }
+
+  file_.close();
+  is_open_ = false;
+}
+
+void BinaryDataWriter::Block::clear() {
+  labels.clear();
+  row_offsets.assign(1, 0);
+  indices.clear();
+  values.clear();
+  max_feature_id = 0;
+}
+
+void BinaryDataWriter::writeDatasets(const CSRDataset *datasets,
+                                     size_t num_datasets) {
+  // Position of the first example of each dataset in the sequence.
+  std::vector<size_t> dataset_offsets(1, 0);
+  for(size_t d = 0; d < num_datasets; ++d) {
+    dataset_offsets.push_back(dataset_offsets.back() + datasets[d].size());
+  }
+
+  const size_t num_examples = dataset_offsets.back();
+  if(num_examples == 0) {return;}
+
+  // The first block completes the pending one; the last block stays pending
+  // if it is not full.
+  const size_t block_size = examples_per_block_;
+  const size_t first_size = std::min(block_size - pending_.size(),
+                                     num_examples);
+  const size_t num_blocks =
+      1 + (num_examples - first_size + block_size - 1) / block_size;
+  std::vector<Block> blocks(num_blocks);
+  std::swap(blocks[0], pending_);
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_t b = 0; b < num_blocks; ++b) {
+    const size_t begin = (b == 0) ?0 :first_size + (b - 1) * block_size;
+    const size_t end = (b == 0) ?first_size
+        :std::min(begin + block_size, num_examples);
+    size_t d = std::upper_bound(dataset_offsets.begin(),
+                                dataset_offsets.end(), begin)
+        - dataset_offsets.begin() - 1;
+
+    for(size_t i = begin; i < end; ++i) {
+      while(i >= dataset_offsets[d + 1]) {++d;}
+      const size_t row = i - dataset_offsets[d];
+      blocks[b].append(datasets[d][row], datasets[d].labels()[row]);
+    }
+
+    if(blocks[b].size() == block_size) {encode(&blocks[b]);}
+  }
+
+  for(Block &block : blocks) {
+    max_feature_id_ = std::max(max_feature_id_, block.max_feature_id);
+    if(block.size() == block_size) {
+      append(block);
+    } else {
+      std::swap(block, pending_);
+    }
+  }
+
+  num_examples_ += num_examples;
+}
+
+void BinaryDataWriter::flushBlock() {
+  if(pending_.size() == 0) {return;}
+
+  encode(&pending_);
+  append(pending_);
+  pending_.clear();
+}
+
+void BinaryDataWriter::append(const Block &block) {
+  if(version_ == 2) {
+    blocks_.push_back(block.info);
+    blocks_.back().offset = file_.size();
+  }
+
+  file_.write(block.output.data(), block.output.size());
+  num_nonzero_ += block.indices.size();
+}
+
+void BinaryDataWriter::encode(Block *block) const {
+  const size_t num_examples = block->size();
+  const size_t num_nonzero = block->indices.size();
+  std::vector<char> &output = block->output;
+
+  if(version_ == 1) {
+    output.resize(num_examples * BIN_EXAMPLE_HEADER_SIZE
+                  + num_nonzero * sizeof(BinEntry));
+    char *ptr = output.data();
+
+    for(size_t i = 0; i < num_examples; ++i) {
+      *reinterpret_cast<BinLabel *>(ptr) = static_cast<int>(block->labels[i]);
+      ptr += sizeof(BinLabel);
+
+      const int64_t *row_offsets = block->row_offsets.data();
+      BinNZFeatCount row_size = row_offsets[i+1] - row_offsets[i];
+      memcpy(ptr, &row_size, sizeof(row_size));
+      ptr += sizeof(BinNZFeatCount);
+
+      for(int64_t j = row_offsets[i]; j < row_offsets[i+1]; ++j) {
+        BinEntry entry = {block->indices[j], block->values[j]};
+        memcpy(ptr, &entry, sizeof(entry));
+        ptr += sizeof(BinEntry);
+      }
+    }
+  } else {
+    block->encoded_indices.clear();
+    binV2EncodeIndices(flags_, block->indices.data(),
+                       block->row_offsets.data(), num_examples,
+                       &block->encoded_indices);
+    block->encoded_values.clear();
+    binV2EncodeValues(flags_, block->values.data(), num_nonzero,
+                      &block->encoded_values);
+
+    BinV2BlockInfo &info = block->info;
+    info.offset = 0;
+    info.num_nonzero = num_nonzero;
+    info.indices_size = block->encoded_indices.size();
+    info.values_size = block->encoded_values.size();
+
+    BinV2BlockLayout layout(num_examples, info);
+    info.size = layout.size;
+    output.assign(layout.size, 0);
+    char *ptr = output.data();
+
+    memcpy(ptr + layout.labels, block->labels.data(),
+           num_examples * sizeof(float));
+    memcpy(ptr + layout.row_offsets, block->row_offsets.data(),
+           (num_examples + 1) * sizeof(int64_t));
+    memcpy(ptr + layout.indices, block->encoded_indices.data(),
+           info.indices_size);
+    memcpy(ptr + layout.values, block->encoded_values.data(),
+           info.values_size);
+
+    info.checksum = binV2Checksum(ptr + layout.labels,
+                                  num_examples * sizeof(float));
+    info.checksum = binV2Checksum(ptr + layout.row_offsets,
+                                  (num_examples + 1) * sizeof(int64_t),
+                                  info.checksum);
+    info.checksum = binV2Checksum(ptr + layout.indices,
+                                  info.indices_size, info.checksum);
+    info.checksum = binV2Checksum(ptr + layout.values,
+                                  info.values_size, info.checksum);
+  }
+}
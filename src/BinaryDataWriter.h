@@ -0,0 +1,138 @@
+#ifndef _SVRG_BINARYDATAWRITER_H_
+#define _SVRG_BINARYDATAWRITER_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "AsyncFileWriter.h"
+#include "BinaryFormat.h"
+#include "CSRDataset.h"
+#include "DataReader.h"
+
+// Writes examples to a binary file in version 1 (see svm2bin) or
+// version 2 (see BinaryFormat.h) format. Version 2 files can be compressed
+// by passing a combination of BIN_V2_*_INDICES/VALUES flags.
+// Serialized examples are written by a background thread (see
+// AsyncFileWriter), so the caller can prepare the next examples meanwhile.
+// Datasets are split into blocks that are serialized in parallel.
+class BinaryDataWriter {
+ public:
+  BinaryDataWriter(const std::string &file_name, int version = 2,
+                   int examples_per_block = DEFAULT_EXAMPLES_PER_BLOCK,
+                   uint32_t flags = 0)
+      : file_name_(file_name), version_(version),
+        examples_per_block_(examples_per_block), flags_(flags) {}
+
+  ~BinaryDataWriter() {if(is_open_) {close();}}
+
+  BinaryDataWriter(const BinaryDataWriter &) = delete;
+  BinaryDataWriter &operator=(const BinaryDataWriter &) = delete;
+
+  bool open();
+
+  // Writes the remaining examples and the header.
+  // The number of features is one plus the largest feature index written.
+  void close();
+
+  // Appends an example. Feature indices must be in increasing order.
+  template<class IterableVector>
+  void write(const IterableVector &example, double label) {
+    pending_.append(example, label);
+    max_feature_id_ = std::max(max_feature_id_, pending_.max_feature_id);
+    ++num_examples_;
+
+    if(pending_.size() == (size_t) examples_per_block_) {
+      flushBlock();
+    }
+  }
+
+  // Appends all examples of a dataset in order.
+  void write(const CSRDataset &examples) {writeDatasets(&examples, 1);}
+
+  // Appends all examples of the datasets in order, as one sequence: blocks
+  // may span several datasets. The output is the same as when writing the
+  // examples one by one.
+  void write(const std::vector<CSRDataset> &datasets) {
+    writeDatasets(datasets.data(), datasets.size());
+  }
+
+  BinExampleCount num_examples() const {return num_examples_;}
+  int num_features() const {return max_feature_id_ + 1;}
+
+  // Makes the file declare at least num_features features, even if the
+  // last features do not occur in any example.
+  void set_min_num_features(int num_features) {
+    max_feature_id_ = std::max(max_feature_id_, num_features - 1);
+  }
+
+  static constexpr int DEFAULT_EXAMPLES_PER_BLOCK = 16384;
+
+ private:
+  // Examples of a block and, once encoded, its bytes in the file.
+  struct Block {
+    Block() : row_offsets(1, 0) {}
+
+    std::vector<float> labels;
+    std::vector<int64_t> row_offsets;
+    std::vector<int32_t> indices;
+    std::vector<float> values;
+    SparseExample::Index max_feature_id = 0;
+
+    std::vector<char> output;
+    std::vector<char> encoded_indices;
+    std::vector<char> encoded_values;
+    BinV2BlockInfo info; // Of version 2 blocks; the offset is set by append.
+
+    size_t size() const {return labels.size();}
+
+    template<class IterableVector>
+    void append(const IterableVector &example, double label) {
+      VectorIterator<IterableVector> iterator(example);
+
+      for(; iterator; iterator.next()) {
+        const SparseExample::Index index = iterator.index();
+        indices.push_back(index);
+        values.push_back(iterator.value());
+        if(index > max_feature_id) {
+          max_feature_id = index;
+        }
+      }
+
+      row_offsets.push_back(indices.size());
+      labels.push_back(label);
+    }
+
+    void clear();
+  };
+
+  void writeDatasets(const CSRDataset *datasets, size_t num_datasets);
+
+  // Serializes the examples of a block into its output, as a version 2
+  // block or in version 1 format. Blocks can be encoded concurrently.
+  void encode(Block *block) const;
+
+  // Appends an encoded block to the file.
+  void append(const Block &block);
+
+  // Writes the pending examples.
+  void flushBlock();
+
+  std::string file_name_;
+  int version_;
+  int examples_per_block_;
+  uint32_t flags_;
+  AsyncFileWriter file_;
+  bool is_open_ = false;
+
+  BinExampleCount num_examples_ = 0;
+  int64_t num_nonzero_ = 0;
+  SparseExample::Index max_feature_id_ = 0;
+
+  // Examples that are not written yet.
+  Block pending_;
+
+  std::vector<BinV2BlockInfo> blocks_;
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "BinaryFormat.h"
+
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+BinV2BlockLayout::BinV2BlockLayout(int64_t num_examples,
+                                   const BinV2BlockInfo &info) {
+  labels = 0;
+  row_offsets = binV2Align(labels + num_examples * sizeof(float));
+  indices = binV2Align(row_offsets + (num_examples + 1) * sizeof(int64_t));
+  values = binV2Align(indices + info.indices_size);
+  size = binV2Align(values + info.values_size);
+}
+
+uint64_t binV2Checksum(const void *data, size_t size, uint64_t seed) {
+  const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+  const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+
+  const char *bytes = static_cast<const char *>(data);
+  uint64_t checksum = seed ^ (size * PRIME1);
+  size_t num_words = size / sizeof(uint64_t);
+
+  for(size_t i = 0; i < num_words; ++i) {
+    uint64_t word;
+    memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+    checksum ^= word * PRIME2;
+    checksum = ((checksum << 31) | (checksum >> 33)) * PRIME1;
+  }
+
+  size_t tail_size = size - num_words * sizeof(uint64_t);
+  if(tail_size > 0) {
+    uint64_t word = 0;
+    memcpy(&word, bytes + num_words * sizeof(uint64_t), tail_size);
+    checksum ^= word * PRIME2;
+    checksum = ((checksum << 31) | (checksum >> 33)) * PRIME1;
+  }
+
+  return checksum;
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t x;
+  memcpy(&x, &value, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t abs = x & 0x7fffffff;
+
+  // Infinity and NaN
+  if(abs >= 0x7f800000) {return sign | 0x7c00 | (abs > 0x7f800000 ?0x200 :0);}
+  // Rounds to infinity (65520 and above)
+  if(abs >= 0x477ff000) {return sign | 0x7c00;}
+
+  // Zero and subnormal halfs (below 2^-14) are multiples of 2^-24.
+  if(abs < 0x38800000) {
+    float abs_value;
+    memcpy(&abs_value, &abs, sizeof(abs_value));
+    return sign | static_cast<uint16_t>(nearbyintf(abs_value * 16777216.0f));
+  }
+
+  // Rebiases the exponent from 127 to 15 and rounds the mantissa to 10 bits.
+  abs += 0xfff + ((abs >> 13) & 1);
+  abs -= 112u << 23;
+  return sign | (abs >> 13);
+}
+
+float halfToFloat(uint16_t value) {
+  uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+
+  if(exponent == 0) {
+    float abs_value = mantissa * (1.0f / 16777216.0f);
+    return sign ?-abs_value :abs_value;
+  }
+
+  uint32_t x = sign | (mantissa << 13);
+  x |= (exponent == 31) ?0x7f800000 :(exponent + 112) << 23;
+  float result;
+  memcpy(&result, &x, sizeof(result));
+  return result;
+}
+
+// Size in bytes of num_nonzero values encoded according to flags.
+static int64_t encodedValuesSize(uint32_t flags, int64_t num_nonzero) {
+  if(flags & BIN_V2_FLOAT16_VALUES) {return num_nonzero * sizeof(uint16_t);}
+  if(flags & BIN_V2_UINT8_VALUES) {return 2 * sizeof(float) + num_nonzero;}
+  return num_nonzero * sizeof(float);
+}
+
+void binV2EncodeIndices(uint32_t flags, const int32_t *indices,
+                        const int64_t *row_offsets, int64_t num_examples,
+                        std::vector<char> *output) {
+  if(!(flags & BIN_V2_VARINT_INDICES)) {
+    const char *data = reinterpret_cast<const char *>(indices);
+    output->insert(output->end(), data,
+                   data + row_offsets[num_examples] * sizeof(int32_t));
+    return;
+  }
+
+  for(int64_t i = 0; i < num_examples; ++i) {
+    uint32_t previous = 0;
+
+    for(int64_t j = row_offsets[i]; j < row_offsets[i+1]; ++j) {
+      ASSERT(indices[j] >= (int32_t) previous,
+             "Feature indices must be in increasing order");
+      uint32_t delta = indices[j] - previous;
+      previous = indices[j];
+
+      while(delta >= 0x80) {
+        output->push_back(static_cast<char>(delta | 0x80));
+        delta >>= 7;
+      }
+      output->push_back(static_cast<char>(delta));
+    }
+  }
+}
+
+void binV2DecodeIndices(uint32_t flags, const char *data, size_t size,
+                        const int64_t *row_offsets, int64_t num_examples,
+                        int32_t *indices) {
+  if(!(flags & BIN_V2_VARINT_INDICES)) {
+    ASSERT(size == row_offsets[num_examples] * sizeof(int32_t),
+           "Invalid indices size");
+    memcpy(indices, data, size);
+    return;
+  }
+
+  const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data);
+  const uint8_t *end = ptr + size;
+
+  for(int64_t i = 0; i < num_examples; ++i) {
+    uint32_t index = 0;
+    int32_t *output = indices + row_offsets[i];
+    int32_t *output_end = indices + row_offsets[i+1];
+
+    // Most deltas fit in one byte, so eight of them are decoded at a time
+    // when none of the next eight bytes has its high bit set.
+    while(output_end - output >= 8 && end - ptr >= 8) {
+      uint64_t word;
+      memcpy(&word, ptr, sizeof(word));
+      if(word & 0x8080808080808080ull) {break;}
+
+      for(int k = 0; k < 8; ++k) {
+        index += ptr[k];
+        output[k] = index;
+      }
+      ptr += 8;
+      output += 8;
+    }
+
+    for(; output != output_end; ++output) {
+      uint32_t delta = 0;
+      int shift = 0;
+
+      do {
+        ASSERT(ptr < end && shift < 32, "Corrupt varint indices");
+        delta |= static_cast<uint32_t>(*ptr & 0x7f) << shift;
+        shift += 7;
+      } while(*ptr++ & 0x80);
+
+      index += delta;
+      *output = index;
+    }
+  }
+
+  ASSERT(ptr == end, "Corrupt varint indices");
+}
+
+void binV2EncodeValues(uint32_t flags, const float *values,
+                       int64_t num_nonzero, std::vector<char> *output) {
+  size_t start = output->size();
+
+  if(flags & BIN_V2_FLOAT16_VALUES) {
+    output->resize(start + num_nonzero * sizeof(uint16_t));
+    char *ptr = output->data() + start;
+
+    for(int64_t i = 0; i < num_nonzero; ++i) {
+      uint16_t half = floatToHalf(values[i]);
+      memcpy(ptr + i * sizeof(half), &half, sizeof(half));
+    }
+  } else if(flags & BIN_V2_UINT8_VALUES) {
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    if(num_nonzero > 0) {minimum = maximum = values[0];}
+    for(int64_t i = 1; i < num_nonzero; ++i) {
+      if(values[i] < minimum) {minimum = values[i];}
+      if(values[i] > maximum) {maximum = values[i];}
+    }
+
+    float step = (maximum - minimum) / 255.0f;
+    output->resize(start + 2 * sizeof(float) + num_nonzero);
+    char *ptr = output->data() + start;
+    memcpy(ptr, &minimum, sizeof(minimum));
+    memcpy(ptr + sizeof(minimum), &step, sizeof(step));
+    ptr += 2 * sizeof(float);
+
+    for(int64_t i = 0; i < num_nonzero; ++i) {
+      float level = (step == 0.0f) ?0.0f :(values[i] - minimum) / step;
+      int quantized = static_cast<int>(level + 0.5f);
+      ptr[i] = static_cast<char>(quantized > 255 ?255 :quantized);
+    }
+  } else {
+    const char *data = reinterpret_cast<const char *>(values);
+    output->insert(output->end(), data, data + num_nonzero * sizeof(float));
+  }
+}
+
+void binV2DecodeValues(uint32_t flags, const char *data, int64_t num_nonzero,
+                       float *values) {
+  if(flags & BIN_V2_FLOAT16_VALUES) {
+    int64_t i = 0;
+#ifdef __F16C__
+    for(; i + 8 <= num_nonzero; i += 8) {
+      __m128i halfs = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(data + i * sizeof(uint16_t)));
+      _mm256_storeu_ps(values + i, _mm256_cvtph_ps(halfs));
+    }
+#endif
+    for(; i < num_nonzero; ++i) {
+      uint16_t half;
+      memcpy(&half, data + i * sizeof(half), sizeof(half));
+      values[i] = halfToFloat(half);
+    }
+  } else if(flags & BIN_V2_UINT8_VALUES) {
+    float minimum, step;
+    memcpy(&minimum, data, sizeof(minimum));
+    memcpy(&step, data + sizeof(minimum), sizeof(step));
+    const uint8_t *quantized =
+        reinterpret_cast<const uint8_t *>(data + 2 * sizeof(float));
+
+    for(int64_t i = 0; i < num_nonzero; ++i) {
+      values[i] = minimum + step * quantized[i];
+    }
+  } else {
+    memcpy(values, data, num_nonzero * sizeof(float));
+  }
+}
+
+bool BinaryFileV2::isV2File(const std::string &file_name) {
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if(fd < 0) {return false;}
+
+  char magic[sizeof(BIN_V2_MAGIC)];
+  bool is_v2 = (pread(fd, magic, sizeof(magic), 0) == sizeof(magic))
+      && memcmp(magic, BIN_V2_MAGIC, sizeof(magic)) == 0;
+  ::close(fd);
+  return is_v2;
+}
+
+bool BinaryFileV2::open(const std::string &file_name) {
+  if(file_descriptor_ >= 0) {close();}
+
+  file_name_ = file_name;
+  file_descriptor_ = ::open(file_name.c_str(), O_RDONLY);
+  if(file_descriptor_ < 0) {return false;}
+
+  if(pread(file_descriptor_, &header_, sizeof(header_), 0) != sizeof(header_)
+     || memcmp(header_.magic, BIN_V2_MAGIC, sizeof(BIN_V2_MAGIC)) != 0
+     || header_.version != BIN_V2_VERSION
+     || (header_.flags & ~BIN_V2_ALL_FLAGS) != 0
+     || ((header_.flags & BIN_V2_FLOAT16_VALUES)
+         && (header_.flags & BIN_V2_UINT8_VALUES))) {
+    close();
+    return false;
+  }
+
+  ASSERT(header_.examples_per_block > 0 &&
+         (header_.examples_per_block & (header_.examples_per_block - 1)) == 0,
+         "Invalid block size in " << file_name);
+
+  blocks_.resize(header_.num_blocks);
+  readBytes(blocks_.data(), blocks_.size() * sizeof(BinV2BlockInfo),
+            header_.block_index_offset);
+
+  uint64_t checksum = binV2Checksum(
+      blocks_.data(), blocks_.size() * sizeof(BinV2BlockInfo));
+  ASSERT(checksum == header_.block_index_checksum,
+         "Corrupt block index in " << file_name);
+
+  return true;
+}
+
+void BinaryFileV2::close() {
+  ASSERT(file_descriptor_ >= 0, "BinaryFileV2 already closed");
+  ::close(file_descriptor_);
+  file_descriptor_ = -1;
+}
+
+void BinaryFileV2::readBytes(void *data, size_t size, int64_t offset) const {
+  char *ptr = static_cast<char *>(data);
+
+  while(size > 0) {
+    ssize_t b = pread(file_descriptor_, ptr, size, offset);
+    ASSERT(b > 0, "Could not read " << file_name_);
+    ptr += b;
+    offset += b;
+    size -= b;
+  }
+}
+
+void BinaryFileV2::readBlock(int64_t block, float *labels,
+                             int64_t *row_offsets, int32_t *indices,
+                             float *values) const {
+  const BinV2BlockInfo &info = blocks_[block];
+  const int64_t num_examples = blockNumExamples(block);
+  BinV2BlockLayout layout(num_examples, info);
+
+  readBytes(labels, num_examples * sizeof(float),
+            info.offset + layout.labels);
+  readBytes(row_offsets, (num_examples + 1) * sizeof(int64_t),
+            info.offset + layout.row_offsets);
+
+  uint64_t checksum = binV2Checksum(labels, num_examples * sizeof(float));
+  checksum = binV2Checksum(row_offsets, (num_examples + 1) * sizeof(int64_t),
+                           checksum);
+  ASSERT(row_offsets[0] == 0 && row_offsets[num_examples] == info.num_nonzero,
+         "Invalid row offsets in block " << block << " of " << file_name_);
+
+  std::vector<char> encoded;
+
+  if(header_.flags == 0) {
+    // Uncompressed sections are read in place.
+    ASSERT(info.indices_size == info.num_nonzero * (int64_t) sizeof(int32_t)
+           && info.values_size == info.num_nonzero * (int64_t) sizeof(float),
+           "Invalid section sizes in block " << block << " of " << file_name_);
+    readBytes(indices, info.indices_size, info.offset + layout.indices);
+    readBytes(values, info.values_size, info.offset + layout.values);
+    checksum = binV2Checksum(indices, info.indices_size, checksum);
+    checksum = binV2Checksum(values, info.values_size, checksum);
+  } else {
+    ASSERT(info.values_size == encodedValuesSize(header_.flags, info.num_nonzero),
+           "Invalid section sizes in block " << block << " of " << file_name_);
+    encoded.resize(info.indices_size + info.values_size);
+    readBytes(encoded.data(), info.indices_size, info.offset + layout.indices);
+    readBytes(encoded.data() + info.indices_size, info.values_size,
+              info.offset + layout.values);
+    checksum = binV2Checksum(encoded.data(), info.indices_size, checksum);
+    checksum = binV2Checksum(encoded.data() + info.indices_size,
+                             info.values_size, checksum);
+  }
+
+  ASSERT(checksum == info.checksum,
+         "Checksum mismatch in block " << block << " of " << file_name_);
+
+  if(header_.flags != 0) {
+    binV2DecodeIndices(header_.flags, encoded.data(), info.indices_size,
+                       row_offsets, num_examples, indices);
+    binV2DecodeValues(header_.flags, encoded.data() + info.indices_size,
+                      info.num_nonzero, values);
+  }
+}
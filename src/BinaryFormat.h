@@ -0,0 +1,155 @@
+#ifndef _SVRG_BINARYFORMAT_H_
+#define _SVRG_BINARYFORMAT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Version 2 of the binary dataset format (see svm2bin for version 1).
+//
+// The file starts with a BinV2Header followed by blocks of examples and a
+// block index. Each block holds header.examples_per_block consecutive
+// examples (fewer for the last block), so example i is in block
+// i / examples_per_block. A block stores its examples as four sections, each
+// starting at a multiple of BIN_V2_ALIGNMENT bytes from the start of the file:
+// - Labels (32-bit float per example)
+// - Row offsets (64-bit integer per example plus one). Features of the j-th
+//   example in the block are at [row_offsets[j], row_offsets[j+1]) of the
+//   two following sections.
+// - Feature indices (32-bit integer per non-zero feature)
+// - Feature values (32-bit float per non-zero feature)
+// Padding between sections is zero. The block index (one BinV2BlockInfo per
+// block) starts at header.block_index_offset.
+//
+// header.flags selects compressed encodings of the last two sections:
+// - BIN_V2_VARINT_INDICES: within each example, the first index and the
+//   differences between consecutive indices are stored as LEB128 varints
+//   (7 bits per byte, high bit set on all but the last byte).
+// - BIN_V2_FLOAT16_VALUES: values are IEEE half precision floats.
+// - BIN_V2_UINT8_VALUES: values are quantized to 8 bits. The section starts
+//   with two floats (minimum, step) and value = minimum + step * byte.
+// Row offsets always count non-zero features, not bytes.
+
+constexpr char BIN_V2_MAGIC[8] = {'S', 'V', 'R', 'G', 'B', 'I', 'N', '2'};
+constexpr uint32_t BIN_V2_VERSION = 2;
+constexpr size_t BIN_V2_ALIGNMENT = 64;
+
+constexpr uint32_t BIN_V2_VARINT_INDICES = 1;
+constexpr uint32_t BIN_V2_FLOAT16_VALUES = 2;
+constexpr uint32_t BIN_V2_UINT8_VALUES = 4;
+constexpr uint32_t BIN_V2_ALL_FLAGS =
+    BIN_V2_VARINT_INDICES | BIN_V2_FLOAT16_VALUES | BIN_V2_UINT8_VALUES;
+
+struct BinV2Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;  // Section encodings (BIN_V2_*_INDICES/VALUES)
+  int64_t num_examples;
+  int64_t num_nonzero;
+  int32_t num_features;
+  uint32_t examples_per_block;  // A power of 2
+  int64_t num_blocks;
+  int64_t block_index_offset;
+  uint64_t block_index_checksum;
+};
+static_assert(sizeof(BinV2Header) == 64, "Unexpected header size");
+
+struct BinV2BlockInfo {
+  int64_t offset;  // File offset of the block
+  int64_t num_nonzero;
+  int64_t size;  // Size of the block in bytes (including padding)
+  int64_t indices_size;  // Size of the encoded indices in bytes
+  int64_t values_size;  // Size of the encoded values in bytes
+  uint64_t checksum;  // Checksum of the four sections (see binV2Checksum)
+};
+
+// Offsets of the sections of a block relative to the block start.
+struct BinV2BlockLayout {
+  BinV2BlockLayout(int64_t num_examples, const BinV2BlockInfo &info);
+
+  size_t labels;
+  size_t row_offsets;
+  size_t indices;
+  size_t values;
+  size_t size;
+};
+
+inline size_t binV2Align(size_t offset) {
+  return (offset + BIN_V2_ALIGNMENT - 1) & ~(BIN_V2_ALIGNMENT - 1);
+}
+
+// A 64-bit checksum of a byte array that processes 8 bytes at a time.
+// Checksums can be chained by passing the previous checksum as seed.
+uint64_t binV2Checksum(const void *data, size_t size, uint64_t seed = 0);
+
+// Encodes the indices of a block according to flags and appends them to
+// output. row_offsets has num_examples + 1 entries.
+void binV2EncodeIndices(uint32_t flags, const int32_t *indices,
+                        const int64_t *row_offsets, int64_t num_examples,
+                        std::vector<char> *output);
+
+// Inverse of binV2EncodeIndices. Fails with an assertion if the encoded
+// indices do not match the row offsets.
+void binV2DecodeIndices(uint32_t flags, const char *data, size_t size,
+                        const int64_t *row_offsets, int64_t num_examples,
+                        int32_t *indices);
+
+// Encodes values according to flags and appends them to output.
+void binV2EncodeValues(uint32_t flags, const float *values,
+                       int64_t num_nonzero, std::vector<char> *output);
+
+void binV2DecodeValues(uint32_t flags, const char *data, int64_t num_nonzero,
+                       float *values);
+
+// Conversions between float and IEEE half precision (round to nearest even).
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// Random access to the blocks of a version 2 binary file.
+// Blocks are read with pread, so readBlock can be called concurrently.
+class BinaryFileV2 {
+ public:
+  BinaryFileV2() {}
+  ~BinaryFileV2() {if(file_descriptor_ >= 0) {close();}}
+
+  BinaryFileV2(const BinaryFileV2 &) = delete;
+  BinaryFileV2 &operator=(const BinaryFileV2 &) = delete;
+
+  // Returns true if the file starts with the version 2 magic string.
+  static bool isV2File(const std::string &file_name);
+
+  // Opens the file and reads its header and block index. Returns false if the
+  // file cannot be opened or is not a valid version 2 file.
+  bool open(const std::string &file_name);
+  void close();
+
+  const BinV2Header &header() const {return header_;}
+  const BinV2BlockInfo &blockInfo(int64_t block) const {return blocks_[block];}
+
+  int64_t blockStart(int64_t block) const {
+    return block * header_.examples_per_block;
+  }
+
+  int64_t blockNumExamples(int64_t block) const {
+    int64_t remaining = header_.num_examples - blockStart(block);
+    return remaining < header_.examples_per_block
+        ?remaining :header_.examples_per_block;
+  }
+
+  // Reads the sections of a block into the given arrays, which must hold
+  // blockNumExamples(block) labels, blockNumExamples(block) + 1 row offsets
+  // and blockInfo(block).num_nonzero indices and values. Compressed sections
+  // are decoded. Fails with an assertion if the block checksum does not match.
+  void readBlock(int64_t block, float *labels, int64_t *row_offsets,
+                 int32_t *indices, float *values) const;
+
+ private:
+  void readBytes(void *data, size_t size, int64_t offset) const;
+
+  std::string file_name_;
+  int file_descriptor_ = -1;
+  BinV2Header header_;
+  std::vector<BinV2BlockInfo> blocks_;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "CSRDataset.h"
+
+#include <cmath>
+
+#include "Numa.h"
+
+void CSRDataset::clear() {
+  row_offsets_.assign(1, 0);
+  indices_.clear();
+  values_.clear();
+  labels_.clear();
+  scales_.clear();
+}
+
+void CSRDataset::reserve(size_t num_examples, size_t num_nonzero) {
+  row_offsets_.reserve(num_examples + 1);
+  indices_.reserve(num_nonzero);
+  values_.reserve(num_nonzero);
+  labels_.reserve(num_examples);
+}
+
+void CSRDataset::resize(size_t num_examples, size_t num_nonzero) {
+  row_offsets_.resize(num_examples + 1);
+  row_offsets_[0] = 0;
+  row_offsets_[num_examples] = num_nonzero;
+  indices_.resize(num_nonzero);
+  values_.resize(num_nonzero);
+  labels_.resize(num_examples);
+  if(!scales_.empty()) {scales_.resize(num_examples, 1.0);}
+}
+
+void CSRDataset::normalize() {
+  const size_t n = size();
+  scales_.resize(n);
+
+  #pragma omp parallel for schedule(static)
+  for(size_t i = 0; i < n; ++i) {
+    double norm = 0.0;
+
+    for(size_t j = row_offsets_[i]; j < row_offsets_[i+1]; ++j) {
+      double value = values_[j];
+      norm += value * value;
+    }
+
+    norm = sqrt(norm);
+    scales_[i] = (norm == 0.0) ?1.0 :1.0 / norm;
+  }
+}
+
+void CSRDataset::normalize(const std::vector<double> &norms, size_t first) {
+  const size_t n = size();
+  ASSERT(first + n <= norms.size(), "Missing example norms");
+  scales_.resize(n);
+
+  for(size_t i = 0; i < n; ++i) {
+    double norm = norms[first + i];
+    scales_[i] = (norm == 0.0) ?1.0 :1.0 / norm;
+  }
+}
+
+void CSRDataset::placeOnNumaNodes(int num_threads) const {
+  const size_t n = size();
+
+  for(int t = 0; t < num_threads; ++t) {
+    const size_t begin = n * t / num_threads;
+    const size_t end = n * (t + 1) / num_threads;
+    const int node = Numa::nodeOfThread(t, num_threads);
+    const size_t first = row_offsets_[begin];
+    const size_t num_nonzero = row_offsets_[end] - first;
+
+    Numa::bind(indices_.data() + first, num_nonzero * sizeof(int), node);
+    Numa::bind(values_.data() + first, num_nonzero * sizeof(float), node);
+    Numa::bind(row_offsets_.data() + begin, (end - begin) * sizeof(size_t),
+               node);
+    Numa::bind(labels_.data() + begin, (end - begin) * sizeof(double), node);
+    if(!scales_.empty()) {
+      Numa::bind(scales_.data() + begin, (end - begin) * sizeof(double), node);
+    }
+  }
+}
+
+CSRDataset CSRDataset::select(const std::vector<int> &example_ids) const {
+  CSRDataset output;
+  output.num_features_ = num_features_;
+
+  size_t num_nonzero = 0;
+  for(int i : example_ids) {num_nonzero += row_offsets_[i+1] - row_offsets_[i];}
+  output.reserve(example_ids.size(), num_nonzero);
+
+  for(int i : example_ids) {
+    output.indices_.insert(output.indices_.end(),
+                           indices_.begin() + row_offsets_[i],
+                           indices_.begin() + row_offsets_[i+1]);
+    output.values_.insert(output.values_.end(),
+                          values_.begin() + row_offsets_[i],
+                          values_.begin() + row_offsets_[i+1]);
+    output.row_offsets_.push_back(output.indices_.size());
+    output.labels_.push_back(labels_[i]);
+    if(!scales_.empty()) {output.scales_.push_back(scales_[i]);}
+  }
+
+  return output;
+}
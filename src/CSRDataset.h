@@ -0,0 +1,137 @@
+#ifndef _SVRG_CSRDATASET_H_
+#define _SVRG_CSRDATASET_H_
+
+#include <vector>
+
+#include "HugePages.h"
+#include "Vector.h"
+
+// Read-only view of an example stored in a CSRDataset.
+// Values are multiplied by 'scale' on access.
+struct CSRRowView {
+  typedef int Index;
+
+  const int *indices;
+  const float *values;
+  int num_nonzero;
+  double scale;
+
+  size_t size() const {return num_nonzero;}
+};
+
+template<>
+class VectorIterator<CSRRowView> {
+ public:
+  VectorIterator(const CSRRowView &vector)
+      : index_(vector.indices), value_(vector.values),
+        end_index_(vector.indices + vector.num_nonzero),
+        scale_(vector.scale) {}
+
+  int index() const {return *index_;}
+  double value() const {return scale_ * *value_;}
+
+  operator bool() const {return index_ != end_index_;}
+  void next() {++index_; ++value_;}
+
+ private:
+  const int *index_;
+  const float *value_;
+  const int *end_index_;
+  double scale_;
+};
+
+// A set of sparse examples stored in compressed sparse row format.
+// All examples share four arrays (row offsets, feature indices, feature values
+// and labels), so a dataset needs a constant number of allocations and
+// consecutive examples are adjacent in memory. The row offset and feature
+// arrays are on huge pages if enabled (see HugePages).
+class CSRDataset {
+ public:
+  typedef CSRRowView value_type;
+
+  CSRDataset() : row_offsets_(1, 0) {}
+
+  void clear();
+  void reserve(size_t num_examples, size_t num_nonzero);
+
+  // Resizes the arrays to hold the given number of examples and non-zero
+  // features. Used by loaders that fill the arrays in place through the
+  // *_data() accessors below.
+  void resize(size_t num_examples, size_t num_nonzero);
+
+  size_t *row_offsets_data() {return row_offsets_.data();}
+  int *indices_data() {return indices_.data();}
+  float *values_data() {return values_.data();}
+  double *labels_data() {return labels_.data();}
+  const size_t *row_offsets_data() const {return row_offsets_.data();}
+  const int *indices_data() const {return indices_.data();}
+  const float *values_data() const {return values_.data();}
+
+  // Appends an example. Feature indices must be in increasing order.
+  template<class IterableVector>
+  void addExample(const IterableVector &example, double label) {
+    VectorIterator<IterableVector> iterator(example);
+
+    for(; iterator; iterator.next()) {
+      indices_.push_back(iterator.index());
+      values_.push_back(iterator.value());
+    }
+
+    row_offsets_.push_back(indices_.size());
+    labels_.push_back(label);
+    if(!scales_.empty()) {scales_.push_back(1.0);}
+  }
+
+  // Scales every example to have a unit L2 norm. The stored values are not
+  // modified, a scale factor is applied on access instead.
+  void normalize();
+
+  // Same as normalize() with precomputed norms, where norms[first + i] is
+  // the L2 norm of example i (see DatasetStats).
+  void normalize(const std::vector<double> &norms, size_t first = 0);
+
+  // Moves each of num_threads contiguous blocks of examples to the NUMA
+  // node of the thread with the same index (see Numa). With a static
+  // schedule over the examples, each thread then reads its own node.
+  void placeOnNumaNodes(int num_threads) const;
+
+  // Returns a new dataset containing the specified examples in the given order.
+  CSRDataset select(const std::vector<int> &example_ids) const;
+
+  size_t size() const {return labels_.size();}
+  size_t num_nonzero() const {return indices_.size();}
+
+  int num_features() const {return num_features_;}
+  void set_num_features(int num_features) {num_features_ = num_features;}
+
+  const std::vector<double> &labels() const {return labels_;}
+  std::vector<double> *mutable_labels() {return &labels_;}
+
+  CSRRowView operator[](size_t i) const {
+    CSRRowView view;
+    size_t start = row_offsets_[i];
+    view.indices = indices_.data() + start;
+    view.values = values_.data() + start;
+    view.num_nonzero = row_offsets_[i+1] - start;
+    view.scale = scales_.empty() ?1.0 :scales_[i];
+    return view;
+  }
+
+ private:
+  int num_features_ = 0;
+
+  // Example i occupies positions [row_offsets_[i], row_offsets_[i+1])
+  // of indices_ and values_.
+  template<class T>
+  using Array = std::vector<T, HugePageAllocator<T>>;
+
+  Array<size_t> row_offsets_;
+  Array<int> indices_;
+  Array<float> values_;
+  std::vector<double> labels_;
+
+  // Per-example scale factors. Empty if examples are not scaled.
+  std::vector<double> scales_;
+};
+
+#endif
@@ -1,6 +1,11 @@
 #include "DataReader.h"
 #include <cstring>
 #include <cmath>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "Platform.h"
+#include "TextParsing.h"
 
 bool SVMDataReader::read(SparseExample* example) {
 	if (ptr_ == buffer_end_) { 
@@ -22,93 +27,109 @@ bool SVMDataReader::read(SparseExample* example) {
 		// Buffer ended before finding the end of the line. 
 		// Move remaining data into stash and read from the file
 		// into the buffer.
-		readMoreBytes();
-
-		p = (char*) memchr(buffer_, '\n', buffer_end_ - buffer_);
+		// A line can span several (prefetch) buffers.
+		do {
+			readMoreBytes();
+			p = (char*) memchr(buffer_, '\n', buffer_end_ - buffer_);
+		} while (p == 0 && !end_of_file_);
 		ASSERT(p != 0, "Insufficient buffer");
 	}
 
-	//processLine
-	processLine(ptr_, p - ptr_, example);
+	parseLine(ptr_, p, example);
 	ptr_ = p+1;
 	++num_examples_;
 	return true;
 }
 
-void SVMDataReader::processLine(char *line, size_t size,
-                                SparseExample* example) {
+void SVMDataReader::parseLine(const char *line, const char *end,
+                              SparseExample* example) {
+  example->feats.clear();
 
-  line[size] = 0;
+  DelimiterScanner scanner(line, end);
+  const char *token = line;
+  const char *delimiter = scanner.next();
+  double label = 0.0;
 
-  // Trim trailing white space
-  while (line[size-1] == ' ') {
-    line[--size] = 0;
+  // A line can be empty if all features are zero and the label is missing.
+  if (delimiter > token) {
+    bool valid = TextParsing::parseDouble(token, delimiter, &label);
+    ASSERT(valid, "Invalid label in line: " << std::string(line, end));
   }
-  
-  char *end = line + size;
-     
-  char *label_end = (char*) memchr(line, ' ', size);
 
-  if (label_end != 0) { // label_end can be 0 if all features are zero
-    *label_end = 0;
-  }
-    
-  example->label = atof(line);
+  example->label = label;
 
-  if (label_end != 0) {
-    SparseExample::Index index; double value;
+  while (delimiter < end) {
+    token = delimiter + 1;
+    delimiter = scanner.next();
 
-    char *last_p = label_end + 1;
-    char *p = last_p;
-    
-    while((p = (char*) memchr(p+1, ' ', end-p-1)) != 0) {
-      // Process Token		
-      processToken(last_p, p-last_p, &index, &value);
-      example->feats.addElement(index, value);
-      last_p = p+1;
-    }
+    // Skip repeated blanks
+    if (delimiter == token) { continue; }
 
-    // Process last token in file
-    processToken(last_p, end-last_p, &index, &value);
-    example->feats.addElement(index, value);
-  }
-}
+    ASSERT(delimiter < end && *delimiter == ':',
+           "Invalid token in line: " << std::string(line, end));
+
+    SparseExample::Index index;
+    bool valid = TextParsing::parseIndex(token, delimiter, &index);
+
+    token = delimiter + 1;
+    delimiter = scanner.next();
 
-void SVMDataReader::processToken(char *token, size_t size, SparseExample::Index *index,
-								 double *value) {
-	token[size] = 0;
-	int idx = 0;	
-	while(*token != ':') idx = (idx)*10 + (*(token++) - '0');
+    double value;
+    valid = valid && TextParsing::parseDouble(token, delimiter, &value);
+    ASSERT(valid, "Invalid token in line: " << std::string(line, end));
 
-	*index = idx;
-	*value = atof(token+1);
+    example->feats.addElement(index, value);
+  }
 }
 
 bool BinaryDataReader::doInit() {
-	Super::doInit();
-
-	num_examples_ = *reinterpret_cast<BinExampleCount *>(ptr_);
-	ptr_ += sizeof(num_examples_);
-	num_features_ = *reinterpret_cast<SparseExample::Index *>(ptr_);
-	ptr_ += sizeof(num_features_);
+	if (!Super::doInit()) { return false; }
+
+	next_example_ = 0;
+	current_block_ = -1;
+
+	if (buffer_end_ - ptr_ >= (ptrdiff_t) sizeof(BIN_V2_MAGIC)
+		&& memcmp(ptr_, BIN_V2_MAGIC, sizeof(BIN_V2_MAGIC)) == 0) {
+		version_ = 2;
+		// Blocks are read through file_v2_, so the buffered file (and its
+		// prefetching) is no longer needed.
+		Super::doClose();
+		if (!file_v2_.open(file_name_)) { return false; }
+
+		num_examples_ = file_v2_.header().num_examples;
+		num_features_ = file_v2_.header().num_features;
+	} else {
+		version_ = 1;
+		num_examples_ = *reinterpret_cast<BinExampleCount *>(ptr_);
+		ptr_ += sizeof(num_examples_);
+		num_features_ = *reinterpret_cast<SparseExample::Index *>(ptr_);
+		ptr_ += sizeof(num_features_);
+	}
 
 	LOG(num_examples_ << " " << num_features_);
 	return true;
 }
 
-struct Entry {
-	SparseExample::Index index;
-	float value;
-};
-static_assert(sizeof(Entry) == sizeof(SparseExample::Index) + sizeof(float), "Size mismatch");
+void BinaryDataReader::doClose() {
+  if (version_ == 2) { file_v2_.close(); }
+  else { Super::doClose(); }
+}
+
+void BinaryDataReader::seek(BinExampleCount example) {
+  ASSERT(version_ == 2, "Seeking is only supported for version 2 files");
+  ASSERT(example >= 0 && example <= num_examples_, "Invalid example " << example);
+  next_example_ = example;
+}
 
 bool BinaryDataReader::read(SparseExample* example) {
-  if (num_examples_ == 0) { return false; }
-  --num_examples_;
+  if (next_example_ == num_examples_) { return false; }
+  if (version_ == 2) { return readV2(example); }
+  ++next_example_;
 
   int read_size = sizeof(BinLabel) + sizeof(BinNZFeatCount);
 	
-  if (read_size > buffer_end_ - ptr_) { readMoreBytes(); }
+  while (read_size > buffer_end_ - ptr_ && !end_of_file_) { readMoreBytes(); }
+  ASSERT(read_size <= buffer_end_ - ptr_, "Truncated binary file");
 	
   BinLabel *label = reinterpret_cast<BinLabel *>(ptr_);
   example->label = *label;
@@ -116,12 +137,13 @@ bool BinaryDataReader::read(SparseExample* example) {
   BinNZFeatCount num_nonzero = *reinterpret_cast<BinNZFeatCount *>(ptr_);
   ptr_ += sizeof(BinNZFeatCount);
  
-  read_size = num_nonzero * sizeof(Entry);
+  read_size = num_nonzero * sizeof(BinEntry);
 
-  if (read_size > buffer_end_ - ptr_) { readMoreBytes(); }
+  // An example can span several (prefetch) buffers.
+  while (read_size > buffer_end_ - ptr_ && !end_of_file_) { readMoreBytes(); }
   ASSERT(read_size <= buffer_end_ - ptr_, "Insufficient buffer");
 
-  Entry *entries = reinterpret_cast<Entry *>(ptr_);
+  BinEntry *entries = reinterpret_cast<BinEntry *>(ptr_);
 
   example->feats.clear();
   example->feats.reserve(num_nonzero);
@@ -134,49 +156,288 @@ bool BinaryDataReader::read(SparseExample* example) {
   return true;
 }
 
+bool BinaryDataReader::readV2(SparseExample* example) {
+  const int64_t block = next_example_ / file_v2_.header().examples_per_block;
+
+  if (block != current_block_) {
+    const int64_t num_block_examples = file_v2_.blockNumExamples(block);
+    const int64_t num_nonzero = file_v2_.blockInfo(block).num_nonzero;
+    block_labels_.resize(num_block_examples);
+    block_row_offsets_.resize(num_block_examples + 1);
+    block_indices_.resize(num_nonzero);
+    block_values_.resize(num_nonzero);
+
+    file_v2_.readBlock(block, block_labels_.data(), block_row_offsets_.data(),
+                       block_indices_.data(), block_values_.data());
+    current_block_ = block;
+  }
+
+  const int64_t i = next_example_ - file_v2_.blockStart(block);
+  ++next_example_;
+
+  example->label = block_labels_[i];
+  example->feats.clear();
+  example->feats.reserve(block_row_offsets_[i+1] - block_row_offsets_[i]);
+
+  for (int64_t j = block_row_offsets_[i]; j < block_row_offsets_[i+1]; ++j) {
+    example->feats.addElement(block_indices_[j], block_values_[j]);
+  }
+
+  return true;
+}
+
+// Reads the blocks of a version 2 file directly into the arrays of a
+// CSRDataset, one block per thread at a time.
+static void readTrainingFileV2(const char *file_name, CSRDataset &data,
+                               bool raw_labels) {
+  BinaryFileV2 file;
+  bool open_succeed = file.open(file_name);
+  ASSERT(open_succeed, "Could not read file" << file_name);
+
+  const BinV2Header &header = file.header();
+  LOG(header.num_examples << " " << header.num_features);
+
+  // Position of the first non-zero feature of each block.
+  std::vector<int64_t> nonzero_starts(header.num_blocks + 1, 0);
+  for (int64_t b = 0; b < header.num_blocks; ++b) {
+    nonzero_starts[b+1] = nonzero_starts[b] + file.blockInfo(b).num_nonzero;
+  }
+
+  data.clear();
+  data.set_num_features(header.num_features);
+  data.resize(header.num_examples, header.num_nonzero);
+
+  size_t *row_offsets = data.row_offsets_data();
+  double *labels = data.labels_data();
+
+  #pragma omp parallel
+  {
+    std::vector<float> block_labels;
+    std::vector<int64_t> block_row_offsets;
+
+    #pragma omp for schedule(dynamic)
+    for (int64_t b = 0; b < header.num_blocks; ++b) {
+      const int64_t start = file.blockStart(b);
+      const int64_t num_block_examples = file.blockNumExamples(b);
+      block_labels.resize(num_block_examples);
+      block_row_offsets.resize(num_block_examples + 1);
+
+      file.readBlock(b, block_labels.data(), block_row_offsets.data(),
+                     data.indices_data() + nonzero_starts[b],
+                     data.values_data() + nonzero_starts[b]);
+
+      for (int64_t i = 0; i < num_block_examples; ++i) {
+        labels[start + i] = raw_labels ?block_labels[i]
+            :(block_labels[i] > 0.0 ?1.0 :0.0);
+        row_offsets[start + i + 1] = nonzero_starts[b] + block_row_offsets[i+1];
+      }
+    }
+  }
+
+  file.close();
+}
+
+static void normalizeExamples(CSRDataset &data,
+                              const std::vector<double> *norms) {
+  if (norms == 0) {
+    data.normalize();
+  } else {
+    ASSERT(norms->size() == data.size(), "Wrong number of example norms");
+    data.normalize(*norms);
+  }
+}
+
 void BinaryDataReader::readTrainingFile(
-    const char *file_name, bool normalize_examples,
-    std::vector<SparseVec> &data, std::vector<double> &labels,
-    int &numFeatures) {    
+    const char *file_name, bool normalize_examples, CSRDataset &data,
+    const std::vector<double> *norms, bool raw_labels) {
+  if (BinaryFileV2::isV2File(file_name)) {
+    readTrainingFileV2(file_name, data, raw_labels);
+    if (normalize_examples) { normalizeExamples(data, norms); }
+    return;
+  }
+
   BinaryDataReader reader(file_name);
-  numFeatures = -1;
   bool init_succeed = reader.init();
   ASSERT(init_succeed, "Could not read file" << file_name);
 
-  numFeatures = reader.num_features();
-  const int num_examples = reader.num_examples();
+  const BinExampleCount num_examples = reader.num_examples();
+
+  // The number of non-zero features follows from the file size.
+  struct stat file_stat;
+  stat(file_name, &file_stat);
+  size_t num_nonzero = (file_stat.st_size - BIN_HEADER_SIZE
+                        - num_examples * BIN_EXAMPLE_HEADER_SIZE)
+      / sizeof(BinEntry);
 
   data.clear();
-  data.reserve(num_examples);
-  labels.clear();
-  labels.reserve(num_examples);
+  data.set_num_features(reader.num_features());
+  data.reserve(num_examples, num_nonzero);
   SparseExample example;
 
-  for(int i = 0; i < num_examples; ++i) {	   
+  for(BinExampleCount i = 0; i < num_examples; ++i) {
     reader.read(&example);
+    data.addExample(example.feats, raw_labels ?example.label
+                    :(example.label > 0.0 ?1.0 :0.0));
 
-    if (normalize_examples) {
-      double norm = 0.0;
-      for(const auto &x : example.feats) {
-        norm += x.second * x.second;
-      }
-      
-      norm = sqrt(norm);
-      if (norm == 0.0) {norm = 1.0;}
+    if(i % 10000 == 0) LOG("Read " << i << " examples");
+  }
 
-      for(auto &x : example.feats) {
-	x.second /= norm;
-      }
+  reader.close();
+
+  if(normalize_examples) {normalizeExamples(data, norms);}
+}
+
+bool ParallelSVMDataReader::doInit() {
+  if (file_name_ == "-") {
+    file_descriptor_ = STDIN_FILENO;
+  } else {
+    file_descriptor_ = ::open(file_name_.c_str(), O_RDONLY);
+    if (file_descriptor_ < 0) { return false; }
+  }
+
+  posix_fadvise(file_descriptor_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  buffer_.resize(block_size_ + 1);
+  buffer_size_ = 0;
+  end_of_file_ = false;
+
+  read_ahead_.resize(block_size_);
+  read_ahead_ready_ = false;
+  stop_read_ahead_ = false;
+  read_ahead_thread_ = std::thread(&ParallelSVMDataReader::readAheadLoop, this);
+  return true;
+}
+
+void ParallelSVMDataReader::doClose() {
+  stopReadAhead();
+  if (file_descriptor_ != STDIN_FILENO) { ::close(file_descriptor_); }
+}
+
+void ParallelSVMDataReader::stopReadAhead() {
+  if (!read_ahead_thread_.joinable()) { return; }
+
+  {
+    std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+    stop_read_ahead_ = true;
+  }
+  read_ahead_cv_.notify_all();
+  read_ahead_thread_.join();
+}
+
+void ParallelSVMDataReader::readAheadLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(read_ahead_mutex_);
+      read_ahead_cv_.wait(lock, [this] {
+          return stop_read_ahead_ || !read_ahead_ready_;});
+      if (stop_read_ahead_) { return; }
     }
-    
-    data.push_back(example.feats);
 
-    double label = example.label > 0.0 ?1.0 :0.0;
-    labels.push_back(label);
+    size_t size = 0;
+    bool end_of_file = false;
 
-    if(i % 10000 == 0) LOG("Read " << i << " examples");
+    while (size < block_size_) {
+      ssize_t b = ::read(file_descriptor_, read_ahead_.data() + size,
+                         block_size_ - size);
+      ASSERT(b >= 0, "Error reading " << file_name_);
+      if (b == 0) { end_of_file = true; break; }
+      size += b;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+      read_ahead_size_ = size;
+      read_ahead_end_of_file_ = end_of_file;
+      read_ahead_ready_ = true;
+    }
+    read_ahead_cv_.notify_all();
+
+    if (end_of_file) { return; }
+  }
+}
+
+void ParallelSVMDataReader::takeReadAhead() {
+  std::unique_lock<std::mutex> lock(read_ahead_mutex_);
+  read_ahead_cv_.wait(lock, [this] {return read_ahead_ready_;});
+
+  // Keeps room for the sentinel.
+  if (buffer_.size() < buffer_size_ + read_ahead_size_ + 1) {
+    buffer_.resize(buffer_size_ + read_ahead_size_ + 1);
+  }
+
+  memcpy(buffer_.data() + buffer_size_, read_ahead_.data(), read_ahead_size_);
+  buffer_size_ += read_ahead_size_;
+  end_of_file_ = read_ahead_end_of_file_;
+
+  read_ahead_ready_ = false;
+  read_ahead_cv_.notify_all();
+}
+
+bool ParallelSVMDataReader::read(std::vector<CSRDataset> *chunks) {
+  if (end_of_file_ && buffer_size_ == 0) { return false; }
+
+  char *parse_end;
+
+  while (true) {
+    if (!end_of_file_) { takeReadAhead(); }
+
+    if (end_of_file_) {
+      // The last line may not end with a newline.
+      parse_end = buffer_.data() + buffer_size_;
+      break;
+    }
+
+    char *last_newline = (char *) memrchr(buffer_.data(), '\n', buffer_size_);
+
+    if (last_newline != 0) {
+      parse_end = last_newline + 1;
+      break;
+    }
+
+    // The buffer does not contain a complete line. Append the next block.
   }
-  
-  reader.close();   
+
+  char *data = buffer_.data();
+  data[buffer_size_] = 0;
+
+  // Split the block into newline-aligned ranges.
+  const int num_ranges = Platform::getNumLocalThreads();
+  std::vector<const char *> bounds(num_ranges + 1);
+  bounds[0] = data;
+  bounds[num_ranges] = parse_end;
+
+  for (int r = 1; r < num_ranges; ++r) {
+    const char *p = data + (parse_end - data) * r / num_ranges;
+    if (p < bounds[r-1]) { p = bounds[r-1]; }
+    const char *newline = (const char *) memchr(p, '\n', parse_end - p);
+    bounds[r] = (newline == 0) ?parse_end :newline + 1;
+  }
+
+  chunks->resize(num_ranges);
+
+  #pragma omp parallel for schedule(static, 1)
+  for (int r = 0; r < num_ranges; ++r) {
+    (*chunks)[r].clear();
+    parseRange(bounds[r], bounds[r+1], &(*chunks)[r]);
+  }
+
+  // Keep the partial line for the next block.
+  buffer_size_ = data + buffer_size_ - parse_end;
+  memmove(data, parse_end, buffer_size_);
+  return true;
 }
 
+void ParallelSVMDataReader::parseRange(const char *begin, const char *end,
+                                       CSRDataset *output) {
+  SparseExample example;
+  const char *line = begin;
+
+  while (line < end) {
+    const char *newline = (const char *) memchr(line, '\n', end - line);
+    if (newline == 0) { newline = end; }
+
+    SVMDataReader::parseLine(line, newline, &example);
+    output->addExample(example.feats, example.label);
+
+    line = newline + 1;
+  }
+}
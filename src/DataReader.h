@@ -1,12 +1,18 @@
 #ifndef _SVRG_DATAREADER_H_
 #define _SVRG_DATAREADER_H_
 
-#include <string>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <unistd.h>
 #include <fcntl.h>
 
+#include "BinaryFormat.h"
+#include "CSRDataset.h"
 #include "Vector.h"
 
 template<class T>
@@ -40,11 +46,35 @@ template<class T>
 class DataReaderFromFile : public DataReader<T> {
  public:
   DataReaderFromFile(const std::string &file_name) 
-      : file_name_(file_name) {}
+      : file_name_(file_name),
+        prefetch_depth_(default_prefetch_depth_),
+        prefetch_buffer_size_(default_prefetch_buffer_size_) {}
+
+  ~DataReaderFromFile() {stopPrefetch();}
+
+  // Makes the reader fill a ring of 'depth' buffers of 'buffer_size' bytes
+  // from a background thread, so that reading the file overlaps with
+  // parsing. A depth of 0 disables prefetching (the file is then read on
+  // demand into a single buffer). Takes effect on the next call to init().
+  void setPrefetch(int depth, size_t buffer_size) {
+    ASSERT(depth == 0 || depth >= 2, "Prefetching needs at least 2 buffers");
+    prefetch_depth_ = depth;
+    prefetch_buffer_size_ = buffer_size;
+  }
+
+  // Prefetch settings of readers constructed afterwards.
+  static void setDefaultPrefetch(int depth, size_t buffer_size) {
+    ASSERT(depth == 0 || depth >= 2, "Prefetching needs at least 2 buffers");
+    default_prefetch_depth_ = depth;
+    default_prefetch_buffer_size_ = buffer_size;
+  }
+
+  static constexpr int DEFAULT_PREFETCH_DEPTH = 4;
+  static constexpr size_t DEFAULT_PREFETCH_BUFFER_SIZE = 4 * 1024 * 1024;
 
  protected:
-  // Reads BUFFER_SIZE bytes from file into buffer. 
-  // Sets buffer_end_ to the end of read bytes.
+  // Makes the next chunk of the file available in [buffer_, buffer_end_).
+  // Returns the number of bytes in the chunk.
   size_t bufferRead();
 
   // Move remaining buffer data into stash and read from the file
@@ -62,7 +92,9 @@ class DataReaderFromFile : public DataReader<T> {
   char storage_[BUFFER_SIZE + STASH_SIZE];
 
   // The buffer stores contents that are from the file to be processed.
-  char * const buffer_ = storage_ + STASH_SIZE;
+  // Without prefetching, it always points into storage_. Otherwise it points
+  // to the ring buffer being consumed.
+  char *buffer_ = storage_ + STASH_SIZE;
 
   // When only a part of an example is stored in the buffer. This part is
   // moved into the stage before rewriting the buffer with new contents.
@@ -74,8 +106,53 @@ class DataReaderFromFile : public DataReader<T> {
 
   int file_descriptor_ = -1; 
   bool end_of_file_ = true;
+
+ private:
+  // A ring buffer. Each buffer is preceded by STASH_SIZE bytes that receive
+  // the partial example left at the end of the previous buffer.
+  struct PrefetchBuffer {
+    std::vector<char> storage;
+    size_t size = 0;
+    bool filled = false;
+
+    char *data() {return storage.data() + STASH_SIZE;}
+  };
+
+  void startPrefetch();
+  void stopPrefetch();
+
+  // Runs on the background thread. Fills buffers in ring order until the
+  // end of the file, which is marked by an empty buffer.
+  void prefetchLoop();
+
+  // Returns the buffer that follows the current one.
+  char *nextBuffer() {
+    if(prefetch_buffers_.empty()) {return buffer_;}
+    return prefetch_buffers_[(consumer_buffer_ + 1) %
+                             prefetch_buffers_.size()].data();
+  }
+
+  int prefetch_depth_;
+  size_t prefetch_buffer_size_;
+
+  std::vector<PrefetchBuffer> prefetch_buffers_;
+  int consumer_buffer_ = -1;  // Buffer being parsed, -1 before the first
+  std::thread prefetch_thread_;
+  std::mutex prefetch_mutex_;
+  std::condition_variable prefetch_cv_;
+  bool stop_prefetch_ = false;
+
+  static int default_prefetch_depth_;
+  static size_t default_prefetch_buffer_size_;
 };
 
+template<class T>
+int DataReaderFromFile<T>::default_prefetch_depth_ = 0;
+
+template<class T>
+size_t DataReaderFromFile<T>::default_prefetch_buffer_size_ =
+    DataReaderFromFile<T>::DEFAULT_PREFETCH_BUFFER_SIZE;
+
 struct SparseExample {
 	typedef int Index;
 
@@ -89,6 +166,12 @@ class SVMDataReader : public DataReaderFromFile<SparseExample> {
 	using Super::Super;
 	virtual bool read(SparseExample* example) override;
 
+	// Parses a line in LIBSVM format ("label index:value index:value ...")
+	// occupying [line, end). The input is not modified. The character at 'end'
+	// (typically the newline) must not be a digit.
+	static void parseLine(const char *line, const char *end,
+						  SparseExample* example);
+
  protected:	
 	virtual bool doInit() override {
 	  num_examples_ = 0;
@@ -96,38 +179,132 @@ class SVMDataReader : public DataReaderFromFile<SparseExample> {
 	}
 
  private:
-	void processLine(char *line, size_t size, SparseExample* example);
-	void processToken(char *token, size_t size, SparseExample::Index *index,
-					  double *value);
-
 	unsigned long long num_examples_;
 };
 
+// Reads a LIBSVM file in large blocks. Each block is split into
+// newline-aligned ranges that are parsed in parallel, one range per thread.
+// Each call to read() returns the examples of one block as a list of
+// datasets (one per range) in file order. Labels are stored unmodified.
+// Lines of any length are supported. The file name "-" reads the standard
+// input, so the input can be a pipe. The next block is read by a background
+// thread while the current one is parsed.
+class ParallelSVMDataReader : public DataReader<std::vector<CSRDataset>> {
+ public:
+  ParallelSVMDataReader(const std::string &file_name,
+                        size_t block_size = DEFAULT_BLOCK_SIZE)
+      : file_name_(file_name), block_size_(block_size) {}
+
+  ~ParallelSVMDataReader() {stopReadAhead();}
+
+  bool read(std::vector<CSRDataset> *chunks) override;
+
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+ protected:
+  bool doInit() override;
+  void doClose() override;
+
+ private:
+  // Parses the complete lines in [begin, end) into output.
+  static void parseRange(const char *begin, const char *end,
+                         CSRDataset *output);
+
+  // Appends the block read by the background thread to buffer_.
+  void takeReadAhead();
+  void stopReadAhead();
+
+  // Runs on the background thread. Reads blocks of block_size_ bytes into
+  // read_ahead_ until the end of the file.
+  void readAheadLoop();
+
+  std::string file_name_;
+  size_t block_size_;
+
+  // Holds the current block followed by a sentinel character.
+  // Bytes of a partial line at the end of a block are moved to the front
+  // before reading the next block.
+  std::vector<char> buffer_;
+  size_t buffer_size_ = 0;
+
+  int file_descriptor_ = -1;
+  bool end_of_file_ = true;
+
+  // Next block, filled by the background thread.
+  std::vector<char> read_ahead_;
+  size_t read_ahead_size_ = 0;
+  bool read_ahead_ready_ = false;
+  bool read_ahead_end_of_file_ = false;
+  bool stop_read_ahead_ = false;
+  std::thread read_ahead_thread_;
+  std::mutex read_ahead_mutex_;
+  std::condition_variable read_ahead_cv_;
+};
+
 typedef char BinLabel;
 typedef long long BinExampleCount;
 typedef int BinNZFeatCount; //Non-zero Feature Count
 
+// A non-zero feature as stored in the binary file.
+struct BinEntry {
+  SparseExample::Index index;
+  float value;
+};
+static_assert(sizeof(BinEntry) == sizeof(SparseExample::Index) + sizeof(float), "Size mismatch");
+
+// Size of the binary file header (number of examples and number of features).
+constexpr size_t BIN_HEADER_SIZE =
+    sizeof(BinExampleCount) + sizeof(SparseExample::Index);
+
+// Size of the per-example header (label and number of non-zero features).
+constexpr size_t BIN_EXAMPLE_HEADER_SIZE =
+    sizeof(BinLabel) + sizeof(BinNZFeatCount);
+
+// Reads examples from a binary file in version 1 (see svm2bin) or
+// version 2 (see BinaryFormat.h) format.
 class BinaryDataReader : public DataReaderFromFile<SparseExample> {
   typedef DataReaderFromFile<SparseExample> Super;
  public:
   using Super::Super;
   virtual bool read(SparseExample* example) override;
 
+  // Moves to the given example, so that the next call to read() returns it.
+  // Only supported for version 2 files.
+  void seek(BinExampleCount example);
+
+  int version() const { return version_; }
   BinExampleCount num_examples() const { return num_examples_;}
   SparseExample::Index num_features() const { return num_features_; }
 
+  // Reads a training file into the arrays of a CSRDataset, which are sized
+  // once from the file header (version 2) or size (version 1), so that
+  // loading does not allocate per example.
+  // Blocks of version 2 files are read in parallel. If norms are given
+  // (see DatasetStats), they are used to normalize examples. Labels are
+  // converted to 0/1 (positive or not) unless raw_labels is set.
   static void readTrainingFile(
-      const char *file_name, bool normalize_examples,
-      std::vector<SparseVec> &data,
-      std::vector<double> &labels,
-      int &numFeatures);
+      const char *file_name, bool normalize_examples, CSRDataset &data,
+      const std::vector<double> *norms = 0, bool raw_labels = false);
 
  protected:
     bool doInit() override;
+    void doClose() override;
 
  private:
+    bool readV2(SparseExample* example);
+
+    int version_;
     BinExampleCount num_examples_;
+    BinExampleCount next_example_;
     SparseExample::Index num_features_;
+
+    // Version 2 files are read one block at a time.
+    BinaryFileV2 file_v2_;
+    int64_t current_block_;
+    std::vector<float> block_labels_;
+    std::vector<int64_t> block_row_offsets_;
+    std::vector<int32_t> block_indices_;
+    std::vector<float> block_values_;
   };
 
 // =================================================================
@@ -142,6 +319,8 @@ bool DataReaderFromFile<T>::doInit() {
 
   end_of_file_ = false;
   posix_fadvise(file_descriptor_, 0, 0, 1);
+  if (prefetch_depth_ > 0) { startPrefetch(); }
+  else { buffer_ = storage_ + STASH_SIZE; }
   bufferRead();
   ptr_ = buffer_;
 	
@@ -150,6 +329,7 @@ bool DataReaderFromFile<T>::doInit() {
 
 template<class T>
 void DataReaderFromFile<T>::doClose() {
+  stopPrefetch();
   ::close(file_descriptor_);
 }
 
@@ -157,21 +337,108 @@ template<class T>
 size_t DataReaderFromFile<T>::bufferRead() {
   ASSERT(!end_of_file_, "Attempting to read after EOF");
 
-  size_t b = ::read(file_descriptor_, buffer_, BUFFER_SIZE);
-  buffer_end_ = buffer_ + b;
-  end_of_file_ = (b == 0);
-  return b;
+  if (prefetch_buffers_.empty()) {
+    size_t b = ::read(file_descriptor_, buffer_, BUFFER_SIZE);
+    buffer_end_ = buffer_ + b;
+    end_of_file_ = (b == 0);
+    return b;
+  }
+
+  // Hands the current buffer back to the background thread and waits for
+  // the next one.
+  const int num_buffers = prefetch_buffers_.size();
+  std::unique_lock<std::mutex> lock(prefetch_mutex_);
+
+  if (consumer_buffer_ >= 0) {
+    prefetch_buffers_[consumer_buffer_].filled = false;
+    prefetch_cv_.notify_all();
+  }
+
+  consumer_buffer_ = (consumer_buffer_ + 1) % num_buffers;
+  PrefetchBuffer &buffer = prefetch_buffers_[consumer_buffer_];
+  prefetch_cv_.wait(lock, [&buffer] {return buffer.filled;});
+
+  buffer_ = buffer.data();
+  buffer_end_ = buffer_ + buffer.size;
+  end_of_file_ = (buffer.size == 0);
+  return buffer.size;
 }
 
 template<class T>
 void DataReaderFromFile<T>::readMoreBytes() {
   const size_t stash_size = buffer_end_ - ptr_;
   ASSERT(stash_size <= STASH_SIZE, "Insufficient stash size");
-  char *stash_ptr = buffer_ - stash_size;	
-  memcpy(stash_ptr, ptr_, stash_size);
+  // The stash area precedes the next buffer. With prefetching, it is not
+  // written by the background thread.
+  char *stash_ptr = nextBuffer() - stash_size;
+  memmove(stash_ptr, ptr_, stash_size);
   ptr_ = stash_ptr;
 
   bufferRead();
 }
 
+template<class T>
+void DataReaderFromFile<T>::startPrefetch() {
+  prefetch_buffers_.resize(prefetch_depth_);
+  for (PrefetchBuffer &buffer : prefetch_buffers_) {
+    buffer.storage.resize(STASH_SIZE + prefetch_buffer_size_);
+    buffer.size = 0;
+    buffer.filled = false;
+  }
+
+  consumer_buffer_ = -1;
+  stop_prefetch_ = false;
+  prefetch_thread_ = std::thread(&DataReaderFromFile<T>::prefetchLoop, this);
+}
+
+template<class T>
+void DataReaderFromFile<T>::stopPrefetch() {
+  if (!prefetch_thread_.joinable()) { return; }
+
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    stop_prefetch_ = true;
+  }
+  prefetch_cv_.notify_all();
+  prefetch_thread_.join();
+  prefetch_buffers_.clear();
+}
+
+template<class T>
+void DataReaderFromFile<T>::prefetchLoop() {
+  const int num_buffers = prefetch_buffers_.size();
+  off_t offset = 0;
+
+  for (int i = 0; ; i = (i + 1) % num_buffers) {
+    PrefetchBuffer &buffer = prefetch_buffers_[i];
+
+    {
+      std::unique_lock<std::mutex> lock(prefetch_mutex_);
+      prefetch_cv_.wait(lock, [this, &buffer] {
+          return stop_prefetch_ || !buffer.filled;});
+      if (stop_prefetch_) { return; }
+    }
+
+    // Fills the whole buffer unless the file ends.
+    size_t size = 0;
+    while (size < prefetch_buffer_size_) {
+      ssize_t b = pread(file_descriptor_, buffer.data() + size,
+                        prefetch_buffer_size_ - size, offset);
+      ASSERT(b >= 0, "Could not read " << file_name_);
+      if (b == 0) { break; }
+      size += b;
+      offset += b;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(prefetch_mutex_);
+      buffer.size = size;
+      buffer.filled = true;
+    }
+    prefetch_cv_.notify_all();
+
+    if (size == 0) { return; }
+  }
+}
+
 #endif
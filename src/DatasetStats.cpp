@@ -0,0 +1,145 @@
+#include "DatasetStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "BinaryFormat.h"
+#include "DataReader.h"
+
+static const char STATS_MAGIC[8] = {'S', 'V', 'R', 'G', 'S', 'T', 'A', '2'};
+
+// Bytes read from each end of the data file for its checksum.
+static const size_t FINGERPRINT_BYTES = 1024 * 1024;
+
+bool DatasetStats::fingerprint(const std::string &data_file, uint64_t *size,
+                               uint64_t *checksum, int64_t *mtime) {
+  FILE *file = fopen(data_file.c_str(), "rb");
+  if(file == 0) {return false;}
+
+  struct stat file_stat;
+  if(fstat(fileno(file), &file_stat) != 0) {
+    fclose(file);
+    return false;
+  }
+
+  fseeko(file, 0, SEEK_END);
+  *size = ftello(file);
+
+  std::vector<char> buffer(std::min<uint64_t>(*size, 2 * FINGERPRINT_BYTES));
+  size_t head_size = std::min<uint64_t>(*size, FINGERPRINT_BYTES);
+  size_t tail_size = buffer.size() - head_size;
+
+  fseeko(file, 0, SEEK_SET);
+  bool success = fread(buffer.data(), 1, head_size, file) == head_size;
+  fseeko(file, *size - tail_size, SEEK_SET);
+  success = success && fread(buffer.data() + head_size, 1, tail_size, file)
+      == tail_size;
+  fclose(file);
+
+  *checksum = binV2Checksum(buffer.data(), buffer.size());
+
+  const bool v2 = head_size >= sizeof(BIN_V2_MAGIC)
+      && memcmp(buffer.data(), BIN_V2_MAGIC, sizeof(BIN_V2_MAGIC)) == 0;
+  *mtime = v2 ?0 :file_stat.st_mtim.tv_sec * INT64_C(1000000000)
+      + file_stat.st_mtim.tv_nsec;
+  return success;
+}
+
+bool DatasetStats::compute(const std::string &data_file) {
+  if(!fingerprint(data_file, &data_size_, &data_checksum_, &data_mtime_)) {
+    return false;
+  }
+
+  BinaryDataReader reader(data_file);
+  if(!reader.init()) {return false;}
+
+  norms_.clear();
+  norms_.reserve(reader.num_examples());
+  feature_counts_.assign(reader.num_features(), 0);
+  SparseExample example;
+
+  while(reader.read(&example)) {
+    // Same order of operations as CSRDataset::normalize, so that scales
+    // derived from the norms are identical.
+    double norm = 0.0;
+
+    for(VectorIterator<SparseVec> it(example.feats); it; it.next()) {
+      norm += it.value() * it.value();
+      ++feature_counts_[it.index()];
+    }
+
+    norms_.push_back(sqrt(norm));
+
+    if(norms_.size() % 1000000 == 0) LOG("Read " << norms_.size() << " examples");
+  }
+
+  reader.close();
+  return (int64_t) norms_.size() == reader.num_examples();
+}
+
+bool DatasetStats::write(const std::string &file_name) const {
+  FILE *file = fopen(file_name.c_str(), "wb");
+  if(file == 0) {return false;}
+
+  const int64_t num_examples = norms_.size();
+  const int32_t num_features = feature_counts_.size();
+
+  bool success = fwrite(STATS_MAGIC, sizeof(STATS_MAGIC), 1, file) == 1
+      && fwrite(&data_size_, sizeof(data_size_), 1, file) == 1
+      && fwrite(&data_checksum_, sizeof(data_checksum_), 1, file) == 1
+      && fwrite(&data_mtime_, sizeof(data_mtime_), 1, file) == 1
+      && fwrite(&num_examples, sizeof(num_examples), 1, file) == 1
+      && fwrite(&num_features, sizeof(num_features), 1, file) == 1
+      && fwrite(norms_.data(), sizeof(double), num_examples, file)
+         == (size_t) num_examples
+      && fwrite(feature_counts_.data(), sizeof(int), num_features, file)
+         == (size_t) num_features;
+
+  return fclose(file) == 0 && success;
+}
+
+bool DatasetStats::read(const std::string &file_name,
+                        const std::string &data_file) {
+  FILE *file = fopen(file_name.c_str(), "rb");
+  if(file == 0) {return false;}
+
+  char magic[sizeof(STATS_MAGIC)];
+  int64_t num_examples = 0;
+  int32_t num_features = 0;
+
+  bool success = fread(magic, sizeof(magic), 1, file) == 1
+      && memcmp(magic, STATS_MAGIC, sizeof(magic)) == 0
+      && fread(&data_size_, sizeof(data_size_), 1, file) == 1
+      && fread(&data_checksum_, sizeof(data_checksum_), 1, file) == 1
+      && fread(&data_mtime_, sizeof(data_mtime_), 1, file) == 1
+      && fread(&num_examples, sizeof(num_examples), 1, file) == 1
+      && fread(&num_features, sizeof(num_features), 1, file) == 1
+      && num_examples >= 0 && num_features >= 0;
+
+  uint64_t size, checksum;
+  int64_t mtime;
+  success = success && fingerprint(data_file, &size, &checksum, &mtime)
+      && size == data_size_ && checksum == data_checksum_
+      && mtime == data_mtime_;
+
+  if(success) {
+    norms_.resize(num_examples);
+    feature_counts_.resize(num_features);
+    success = fread(norms_.data(), sizeof(double), num_examples, file)
+        == (size_t) num_examples
+        && fread(feature_counts_.data(), sizeof(int), num_features, file)
+        == (size_t) num_features;
+  }
+
+  fclose(file);
+
+  if(!success) {
+    norms_.clear();
+    feature_counts_.clear();
+  }
+
+  return success;
+}
@@ -0,0 +1,67 @@
+#ifndef _SVRG_DATASETSTATS_H_
+#define _SVRG_DATASETSTATS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Statistics of a binary data file (version 1 or 2) that training needs
+// before the first epoch: the L2 norm of every example (to normalize
+// examples) and the number of examples where each feature is not zero (to
+// scale the regularization, see Oracle.h).
+// They are computed once (see bin/opt/binstats) and stored in a sidecar file
+// next to the data file, so that later runs skip both passes over the data.
+// The sidecar records the size and a checksum of the data file, and the
+// modification time of version 1 files, and is rejected if the data file
+// changed.
+//
+// Sidecar format (little endian):
+// - Magic "SVRGSTA2" (8 bytes)
+// - Data file size, checksum and modification time (64-bit integers)
+// - Number of examples (64-bit integer) and features (32-bit integer)
+// - Example norms (64-bit float per example)
+// - Feature counts (32-bit integer per feature)
+class DatasetStats {
+ public:
+  // Reads the data file once. Returns false if it cannot be read.
+  bool compute(const std::string &data_file);
+
+  bool write(const std::string &file_name) const;
+
+  // Reads statistics of 'data_file' from 'file_name'. Returns false if the
+  // file does not exist or was computed for a different data file.
+  bool read(const std::string &file_name, const std::string &data_file);
+
+  // Reads the sidecar of 'data_file' if there is a valid one.
+  bool load(const std::string &data_file) {
+    return read(sidecarName(data_file), data_file);
+  }
+
+  static std::string sidecarName(const std::string &data_file) {
+    return data_file + ".stats";
+  }
+
+  int64_t num_examples() const {return norms_.size();}
+  int num_features() const {return feature_counts_.size();}
+
+  const std::vector<double> &norms() const {return norms_;}
+  const std::vector<int> &feature_counts() const {return feature_counts_;}
+
+ private:
+  // Identifies a data file by its size and a checksum of its first and last
+  // bytes, which include the header (and the block index of version 2 files,
+  // which holds a checksum of every block). Version 1 files have no block
+  // checksums, so an edit in their middle is only detected by their
+  // modification time (in ns); it is 0 for version 2 files, so that their
+  // sidecars remain valid when both files are copied.
+  static bool fingerprint(const std::string &data_file, uint64_t *size,
+                          uint64_t *checksum, int64_t *mtime);
+
+  uint64_t data_size_ = 0;
+  uint64_t data_checksum_ = 0;
+  int64_t data_mtime_ = 0;
+  std::vector<double> norms_;
+  std::vector<int> feature_counts_;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "ExampleOrder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+
+// Mixes the bits of a 64-bit integer (the finalizer of MurmurHash3).
+static inline uint64_t mixBits(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Sorts example ids by a key of 'key_size' components per example.
+// Ties keep the original order.
+static std::vector<int> sortByKeys(const std::vector<uint64_t> &keys,
+                                   int key_size) {
+  std::vector<int> order(keys.size() / key_size);
+  std::iota(order.begin(), order.end(), 0);
+
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return std::lexicographical_compare(
+        keys.begin() + (size_t) a * key_size,
+        keys.begin() + (size_t) (a + 1) * key_size,
+        keys.begin() + (size_t) b * key_size,
+        keys.begin() + (size_t) (b + 1) * key_size);
+  });
+
+  return order;
+}
+
+std::vector<int> ExampleOrder::byDominantFeature(const CSRDataset &examples) {
+  const int KEY_SIZE = 3;
+  const int64_t n = examples.size();
+  const size_t *row_offsets = examples.row_offsets_data();
+  const int *indices = examples.indices_data();
+  const float *values = examples.values_data();
+
+  // Empty examples come last.
+  std::vector<uint64_t> keys(n * KEY_SIZE, UINT64_MAX);
+
+  #pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < n; ++i) {
+    const size_t begin = row_offsets[i], end = row_offsets[i+1];
+    if(begin == end) {continue;}
+
+    size_t dominant = begin;
+    for(size_t j = begin + 1; j < end; ++j) {
+      if(fabs(values[j]) > fabs(values[dominant])) {dominant = j;}
+    }
+
+    keys[i * KEY_SIZE] = indices[dominant] / FEATURES_PER_LINE;
+    for(int k = 1; k < KEY_SIZE && begin + k - 1 < end; ++k) {
+      keys[i * KEY_SIZE + k] = indices[begin + k - 1] / FEATURES_PER_LINE;
+    }
+  }
+
+  return sortByKeys(keys, KEY_SIZE);
+}
+
+std::vector<int> ExampleOrder::byMinHash(const CSRDataset &examples,
+                                         int num_hashes) {
+  const int64_t n = examples.size();
+  const size_t *row_offsets = examples.row_offsets_data();
+  const int *indices = examples.indices_data();
+
+  std::vector<uint64_t> keys(n * num_hashes, UINT64_MAX);
+
+  #pragma omp parallel for schedule(static)
+  for(int64_t i = 0; i < n; ++i) {
+    uint64_t *signature = &keys[i * num_hashes];
+
+    for(size_t j = row_offsets[i]; j < row_offsets[i+1]; ++j) {
+      const uint64_t line = indices[j] / FEATURES_PER_LINE;
+      for(int h = 0; h < num_hashes; ++h) {
+        signature[h] = std::min(signature[h], mixBits(line * num_hashes + h));
+      }
+    }
+  }
+
+  return sortByKeys(keys, num_hashes);
+}
+
+std::vector<int> ExampleOrder::random(size_t num_examples, unsigned seed) {
+  std::vector<int> order(num_examples);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(seed);
+  std::shuffle(order.begin(), order.end(), rng);
+  return order;
+}
+
+std::vector<int> ExampleOrder::byMethod(const std::string &method,
+                                        const CSRDataset &examples,
+                                        unsigned seed) {
+  if(method == "dominant") {return byDominantFeature(examples);}
+  if(method == "minhash") {return byMinHash(examples);}
+  if(method == "random") {return random(examples.size(), seed);}
+  ASSERT(false, "Invalid example order " << method);
+  return std::vector<int>();
+}
+
+double ExampleOrder::lineReuse(const CSRDataset &examples, int window) {
+  const size_t *row_offsets = examples.row_offsets_data();
+  const int *indices = examples.indices_data();
+
+  int max_index = examples.num_features() - 1;
+  for(size_t j = 0; j < examples.num_nonzero(); ++j) {
+    max_index = std::max(max_index, indices[j]);
+  }
+
+  // Last example that accessed each line.
+  std::vector<int64_t> last_access(max_index / FEATURES_PER_LINE + 1,
+                                   -window - 1);
+  int64_t accesses = 0, hits = 0;
+
+  for(int64_t i = 0; i < (int64_t) examples.size(); ++i) {
+    int64_t previous_line = -1;
+
+    for(size_t j = row_offsets[i]; j < row_offsets[i+1]; ++j) {
+      const int64_t line = indices[j] / FEATURES_PER_LINE;
+      // Features of an example that share a line count once.
+      if(line == previous_line) {continue;}
+      previous_line = line;
+
+      ++accesses;
+      if(last_access[line] >= i - window) {++hits;}
+      last_access[line] = i;
+    }
+  }
+
+  return accesses == 0 ?0.0 :(double) hits / accesses;
+}
@@ -0,0 +1,46 @@
+#ifndef _SVRG_EXAMPLEORDER_H_
+#define _SVRG_EXAMPLEORDER_H_
+
+#include <string>
+#include <vector>
+
+#include "CSRDataset.h"
+
+// Orders of examples. Under the dominant feature and MinHash orders,
+// consecutive examples share features, so that sequential passes over the
+// data (e.g. the SVRG full gradient or objective evaluation) find the
+// parameters they touch in the cache.
+// Feature indices are grouped into blocks of FEATURES_PER_LINE features,
+// the number of double parameters in a 64-byte cache line.
+class ExampleOrder {
+ public:
+  static constexpr int FEATURES_PER_LINE = 8;
+
+  // Sorts examples by the cache line of their dominant feature (the feature
+  // with the largest absolute value), then by the lines of their first
+  // features.
+  static std::vector<int> byDominantFeature(const CSRDataset &examples);
+
+  // Sorts examples by MinHash signatures of the cache lines they touch.
+  // Two examples share each signature component with probability equal to
+  // the Jaccard similarity of their sets of lines.
+  static std::vector<int> byMinHash(const CSRDataset &examples,
+                                    int num_hashes = 4);
+
+  // A uniformly random order, e.g. to shuffle a file once so that solvers
+  // can visit examples sequentially (see SamplingMode::SEQUENTIAL).
+  static std::vector<int> random(size_t num_examples, unsigned seed);
+
+  // Returns the order named by 'method' ("dominant", "minhash" or
+  // "random"). The seed is used by the random order.
+  static std::vector<int> byMethod(const std::string &method,
+                                   const CSRDataset &examples,
+                                   unsigned seed = 1);
+
+  // Locality of a sequential pass: the fraction of parameter cache line
+  // accesses that hit a line already accessed by one of the previous
+  // 'window' examples.
+  static double lineReuse(const CSRDataset &examples, int window = 64);
+};
+
+#endif
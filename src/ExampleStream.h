@@ -0,0 +1,25 @@
+#ifndef _SVRG_EXAMPLESTREAM_H_
+#define _SVRG_EXAMPLESTREAM_H_
+
+#include <cstdint>
+
+// A source of training examples that are loaded into memory one window at a
+// time. The oracle given to a solver only sees the examples of the current
+// window, and instance ids are relative to the window.
+class ExampleStream {
+ public:
+  virtual ~ExampleStream() {}
+
+  // Total number of examples over all windows.
+  virtual int64_t numExamples() const = 0;
+
+  // Starts a new pass over the examples. The next call to nextWindow()
+  // loads the first window.
+  virtual void rewind() = 0;
+
+  // Replaces the resident examples with the next window.
+  // Returns false (and leaves no examples resident) at the end of a pass.
+  virtual bool nextWindow() = 0;
+};
+
+#endif
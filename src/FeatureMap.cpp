@@ -0,0 +1,64 @@
+#include "FeatureMap.h"
+
+#include <fstream>
+
+FeatureMap FeatureMap::byFrequency(const std::vector<int64_t> &counts,
+                                   int64_t min_count) {
+  FeatureMap map;
+
+  for(size_t i = 0; i < counts.size(); ++i) {
+    if(counts[i] >= min_count && counts[i] > 0) {
+      map.original_indices_.push_back(i);
+    }
+  }
+
+  std::stable_sort(map.original_indices_.begin(), map.original_indices_.end(),
+                   [&counts](int a, int b) {return counts[a] > counts[b];});
+
+  for(int i : map.original_indices_) {map.counts_.push_back(counts[i]);}
+  map.index();
+  return map;
+}
+
+bool FeatureMap::read(const std::string &file_name) {
+  std::ifstream input(file_name);
+  if(!input) {return false;}
+
+  original_indices_.clear();
+  counts_.clear();
+  int original_index;
+  int64_t count;
+
+  while(input >> original_index >> count) {
+    if(original_index < 0) {return false;}
+    original_indices_.push_back(original_index);
+    counts_.push_back(count);
+  }
+
+  if(!input.eof()) {return false;}
+  index();
+  return true;
+}
+
+bool FeatureMap::write(const std::string &file_name) const {
+  std::ofstream output(file_name);
+
+  for(int i = 0; i < num_features(); ++i) {
+    output << original_indices_[i] << " " << counts_[i] << "\n";
+  }
+
+  output.close();
+  return !output.fail();
+}
+
+void FeatureMap::index() {
+  int max_index = -1;
+  for(int i : original_indices_) {max_index = std::max(max_index, i);}
+
+  new_indices_.assign(max_index + 1, -1);
+  for(int i = 0; i < num_features(); ++i) {
+    ASSERT(new_indices_[original_indices_[i]] == -1,
+           "Feature " << original_indices_[i] << " is mapped twice");
+    new_indices_[original_indices_[i]] = i;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef _SVRG_FEATUREMAP_H_
+#define _SVRG_FEATUREMAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Vector.h"
+
+// Renumbers features, e.g. by descending frequency so that the parameters of
+// frequent features share cache lines (see svm2bin --feature_order).
+// Features without a new index are dropped.
+//
+// Map files are text files where line i holds the original index and the
+// number of occurrences of the feature with new index i.
+class FeatureMap {
+ public:
+  // Numbers features that occur at least min_count times by descending
+  // count. Ties keep the original order. counts[i] is the number of
+  // examples where feature i is not zero.
+  static FeatureMap byFrequency(const std::vector<int64_t> &counts,
+                                int64_t min_count);
+
+  bool read(const std::string &file_name);
+  bool write(const std::string &file_name) const;
+
+  int num_features() const {return original_indices_.size();}
+
+  // Returns the new index of a feature or -1 if the feature is dropped.
+  int newIndex(int64_t original_index) const {
+    return original_index < (int64_t) new_indices_.size()
+        ?new_indices_[original_index] :-1;
+  }
+
+  // Writes the features of 'example' that are not dropped to 'output',
+  // in increasing order of their new index.
+  template<class IterableVector>
+  void apply(const IterableVector &example, SparseVec *output) const {
+    entries_.clear();
+
+    for(VectorIterator<IterableVector> iterator(example); iterator;
+        iterator.next()) {
+      int index = newIndex(iterator.index());
+      if(index >= 0) {entries_.emplace_back(index, iterator.value());}
+    }
+
+    std::sort(entries_.begin(), entries_.end());
+    output->clear();
+    for(const auto &entry : entries_) {
+      output->addElement(entry.first, entry.second);
+    }
+  }
+
+ private:
+  // Fills new_indices_ from original_indices_.
+  void index();
+
+  // Original index and count of every new feature.
+  std::vector<int> original_indices_;
+  std::vector<int64_t> counts_;
+
+  // New index of every original feature, or -1.
+  std::vector<int> new_indices_;
+
+  mutable std::vector<std::pair<int, double>> entries_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "HugePages.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <sys/mman.h>
+
+static std::atomic<int> g_mode(HugePageMode::NONE);
+
+// Bytes mapped with each backing, indexed by HugePageMode.
+static std::atomic<size_t> g_mapped_bytes[3];
+
+void HugePages::setMode(HugePageMode mode) {
+  g_mode = mode;
+}
+
+HugePageMode HugePages::mode() {
+  return static_cast<HugePageMode::Mode>(g_mode.load());
+}
+
+static size_t roundUp(size_t size) {
+  return (size + HugePages::HUGE_PAGE_SIZE - 1)
+      & ~(HugePages::HUGE_PAGE_SIZE - 1);
+}
+
+// madvise(MADV_HUGEPAGE) succeeds even if transparent huge pages are
+// disabled, so the system setting is checked as well.
+static bool transparentHugePagesEnabled() {
+  static const bool enabled = [] {
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string setting;
+    std::getline(file, setting);
+    return file && setting.find("[never]") == std::string::npos;
+  }();
+
+  return enabled;
+}
+
+// Maps 'length' bytes of regular pages aligned to HUGE_PAGE_SIZE, so that
+// all of them can be backed by transparent huge pages.
+static void *mapAligned(size_t length) {
+  const size_t padded = length + HugePages::HUGE_PAGE_SIZE;
+  void *ptr = mmap(0, padded, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(ptr == MAP_FAILED) {return 0;}
+
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t aligned = roundUp(begin);
+  if(aligned > begin) {munmap(ptr, aligned - begin);}
+  munmap(reinterpret_cast<void*>(aligned + length),
+         begin + padded - (aligned + length));
+
+  return reinterpret_cast<void*>(aligned);
+}
+
+void *HugePages::allocate(size_t size) {
+  if(size < HUGE_PAGE_SIZE) {return ::operator new(size);}
+
+  const size_t length = roundUp(size);
+  const HugePageMode mode = HugePages::mode();
+
+  if(mode == HugePageMode::EXPLICIT) {
+    // Pages are reserved by mmap, so that a pool that is too small makes it
+    // fail here rather than fault on first touch.
+    void *ptr = mmap(0, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(ptr != MAP_FAILED) {
+      g_mapped_bytes[HugePageMode::EXPLICIT] += length;
+      return ptr;
+    }
+  }
+
+  void *ptr = mapAligned(length);
+  if(ptr == 0) {throw std::bad_alloc();}
+
+  if(mode != HugePageMode::NONE && transparentHugePagesEnabled()
+     && madvise(ptr, length, MADV_HUGEPAGE) == 0) {
+    g_mapped_bytes[HugePageMode::TRANSPARENT] += length;
+  } else {
+    g_mapped_bytes[HugePageMode::NONE] += length;
+  }
+
+  return ptr;
+}
+
+void HugePages::deallocate(void *ptr, size_t size) {
+  if(size < HUGE_PAGE_SIZE) {
+    ::operator delete(ptr);
+  } else {
+    munmap(ptr, roundUp(size));
+  }
+}
+
+// Reads the AnonHugePages line of /proc/self/smaps_rollup, in kB.
+static size_t anonHugePagesKb() {
+  std::ifstream file("/proc/self/smaps_rollup");
+  std::string line;
+
+  while(std::getline(file, line)) {
+    if(line.compare(0, 14, "AnonHugePages:") == 0) {
+      return std::stoul(line.substr(14));
+    }
+  }
+
+  return 0;
+}
+
+std::string HugePages::report() {
+  std::stringstream output;
+  output << "Huge pages: "
+         << (g_mapped_bytes[HugePageMode::EXPLICIT] >> 20) << " MB explicit, "
+         << (g_mapped_bytes[HugePageMode::TRANSPARENT] >> 20)
+         << " MB transparent, "
+         << (g_mapped_bytes[HugePageMode::NONE] >> 20)
+         << " MB regular pages mapped; "
+         << (anonHugePagesKb() >> 10) << " MB on transparent huge pages";
+  return output.str();
+}
@@ -0,0 +1,93 @@
+#ifndef _SVRG_HUGE_PAGES_H_
+#define _SVRG_HUGE_PAGES_H_
+
+#include <cstddef>
+#include <string>
+
+// Page backing of large allocations (see HugePages).
+class HugePageMode {
+ public:
+  enum Mode {
+    NONE, // Regular pages.
+    TRANSPARENT, // Transparent huge pages, requested with madvise.
+    EXPLICIT // Pages of the hugetlbfs pool (MAP_HUGETLB), or TRANSPARENT
+             // if the pool does not have enough free pages.
+  };
+
+  HugePageMode(Mode mode)
+      : mode_(mode) {}
+
+  operator Mode() const {return mode_;}
+
+  std::string toString() const {
+    switch(mode_) {
+      case HugePageMode::NONE: return "NONE"; break;
+      case HugePageMode::TRANSPARENT: return "TRANSPARENT"; break;
+      case HugePageMode::EXPLICIT: return "EXPLICIT"; break;
+      default: return ""; break;
+    }
+  }
+
+  static HugePageMode fromString(const std::string &str) {
+    if(str == "NONE") {return HugePageMode::NONE;}
+    else if(str == "TRANSPARENT") {return HugePageMode::TRANSPARENT;}
+    else if(str == "EXPLICIT") {return HugePageMode::EXPLICIT;}
+    else {ASSERT(false, "Invalid huge page mode.");}
+    return HugePageMode::NONE;
+  }
+
+ private:
+  Mode mode_;
+};
+
+// Allocation of large arrays (dense parameter vectors, dataset storage) on
+// huge pages, so that random accesses over hundreds of MB do not miss the
+// TLB on almost every access (Linux only).
+//
+// Allocations of at least HUGE_PAGE_SIZE bytes are mapped on their own,
+// rounded up and aligned to HUGE_PAGE_SIZE, and backed according to the
+// current mode. Smaller allocations use operator new. Since the backing
+// only depends on the size, memory can be freed after the mode changed.
+// Pages are only requested: if the system has no huge pages available,
+// allocations silently fall back to regular pages, which report() shows.
+class HugePages {
+ public:
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  // Applies to subsequent allocations. The default is NONE.
+  static void setMode(HugePageMode mode);
+  static HugePageMode mode();
+
+  static void *allocate(size_t size);
+  static void deallocate(void *ptr, size_t size);
+
+  // Describes how many bytes were mapped with each backing so far and how
+  // many bytes of the process are currently on transparent huge pages.
+  static std::string report();
+};
+
+// Standard allocator using HugePages.
+template<class T>
+class HugePageAllocator {
+ public:
+  typedef T value_type;
+
+  HugePageAllocator() {}
+  template<class U>
+  HugePageAllocator(const HugePageAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T*>(HugePages::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *ptr, size_t n) {
+    HugePages::deallocate(ptr, n * sizeof(T));
+  }
+
+  template<class U>
+  bool operator==(const HugePageAllocator<U> &) const {return true;}
+  template<class U>
+  bool operator!=(const HugePageAllocator<U> &) const {return false;}
+};
+
+#endif
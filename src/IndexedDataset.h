@@ -0,0 +1,73 @@
+#ifndef _SVRG_INDEXEDDATASET_H_
+#define _SVRG_INDEXEDDATASET_H_
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// A view of selected examples of another dataset (CSRDataset, mapped
+// datasets ... etc.), e.g. the training or test examples of a
+// cross-validation fold. Examples are not copied, only their ids and labels
+// are stored. The viewed dataset must outlive the view.
+template<class Dataset>
+class IndexedDataset {
+ public:
+  typedef typename Dataset::value_type value_type;
+
+  IndexedDataset() {}
+
+  IndexedDataset(const Dataset *dataset, const std::vector<int> &example_ids)
+      : dataset_(dataset), example_ids_(example_ids) {
+    labels_.reserve(example_ids_.size());
+    for(int i : example_ids_) {labels_.push_back(dataset->labels()[i]);}
+  }
+
+  size_t size() const {return example_ids_.size();}
+  value_type operator[](size_t i) const {return (*dataset_)[example_ids_[i]];}
+
+  const std::vector<double> &labels() const {return labels_;}
+  int num_features() const {return dataset_->num_features();}
+
+ private:
+  const Dataset *dataset_ = 0;
+  std::vector<int> example_ids_;
+  std::vector<double> labels_;
+};
+
+// Splits examples [0, num_examples) at random into num_folds folds of
+// (almost) equal size. Ids within each fold are sorted, so that views of a
+// fold access the dataset in stored order.
+inline std::vector<std::vector<int>> crossValidationFolds(
+    int num_examples, int num_folds, unsigned seed) {
+  std::vector<int> ids(num_examples);
+  for(int i = 0; i < num_examples; ++i) {ids[i] = i;}
+  std::mt19937 rng(seed);
+  std::shuffle(ids.begin(), ids.end(), rng);
+
+  std::vector<std::vector<int>> folds(num_folds);
+  for(int f = 0; f < num_folds; ++f) {
+    folds[f].assign(ids.begin() + (int64_t) num_examples * f / num_folds,
+                    ids.begin() + (int64_t) num_examples * (f + 1) / num_folds);
+    std::sort(folds[f].begin(), folds[f].end());
+  }
+
+  return folds;
+}
+
+// Returns the ids of examples [0, num_examples) that are not in 'fold'
+// (sorted), i.e. the training examples of the fold.
+inline std::vector<int> complementOfFold(int num_examples,
+                                         const std::vector<int> &fold) {
+  std::vector<int> ids;
+  ids.reserve(num_examples - fold.size());
+  size_t next = 0;
+
+  for(int i = 0; i < num_examples; ++i) {
+    if(next < fold.size() && fold[next] == i) {++next;}
+    else {ids.push_back(i);}
+  }
+
+  return ids;
+}
+
+#endif
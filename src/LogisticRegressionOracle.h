@@ -3,59 +3,70 @@
 
 #include "Oracle.h"
 
-template<class ParamVector>
-class LogisticRegressionOracle : public SparseExampleOracle<ParamVector, double> {
-  typedef SparseExampleOracle<ParamVector, double> Super;
+template<class ParamVector, class Examples = std::vector<SparseVec>>
+class LogisticRegressionOracle final
+    : public SparseExampleOracle<LogisticRegressionOracle<ParamVector,
+                                                          Examples>,
+                                 ParamVector, double, Examples> {
+  typedef SparseExampleOracle<LogisticRegressionOracle, ParamVector, double,
+                              Examples> Super;
+  friend Super;
   typedef double Label;
+  typedef typename Super::Example Example;
+  typedef typename Super::Gradient Gradient;
  public:
-  LogisticRegressionOracle(const std::vector<SparseVec> *examples,
+  LogisticRegressionOracle(const Examples *examples,
                            const std::vector<Label> *labels,
                            int num_features,
                            double l2_reg,
-                           const std::vector<SparseVec> *test_examples = 0,
-                           const std::vector<Label> *test_labels = 0)
-      : Super(examples, labels, num_features, l2_reg),
+                           const Examples *test_examples = 0,
+                           const std::vector<Label> *test_labels = 0,
+                           const std::vector<int> *feature_counts = 0)
+      : Super(examples, labels, num_features, l2_reg, feature_counts),
         test_examples_(test_examples), test_labels_(test_labels) {}
 
   void evalParams(
       const ParamVector &x,
       std::unordered_map<std::string, double> &output) const override;
-  
-  static void readTrainingFile(
-      const char *fileName, bool normalize_examples,
-      std::vector<SparseVec> &data, std::vector<double> &labels, int &numFeatures);
+
+  bool hasScaledGradients() const override {return true;}
 
  protected:
-  void doComputeGradient(const ParamVector &params, const SparseVec &instance,
-                         const double& label, SparseVec &output) const override {
+  void doComputeGradient(const ParamVector &params, const Example &instance,
+                         const double& label, Gradient &output) const {
     double p = computeP(params, instance);
     computeGradientGivenP(p, instance, label, output);
   }
   
-  double doComputeObjective(const ParamVector &params, const SparseVec &instance,
-                            const double& label) const override {
+  double doComputeObjective(const ParamVector &params, const Example &instance,
+                            const double& label) const {
     double p = computeP(params, instance);
     return computeObjectiveGivenP(p, instance, label);
   }
 
   double doComputeObjAndGradient(const ParamVector &params,
-                                 const SparseVec &instance,
+                                 const Example &instance,
                                  const Label& label,
-                                 SparseVec &out_gradient) const override {
+                                 Gradient &out_gradient) const {
     double p = computeP(params, instance);
     computeGradientGivenP(p, instance, label, out_gradient);
     return computeObjectiveGivenP(p, instance, label);
   }
+
+  double computeScaleGivenMargin(double margin,
+                                 const Label& label) const {
+    return 1.0 / (1.0 + exp(-margin)) - label;
+  }
   
   void computeGradientGivenP(
-      double p, const SparseVec &instance, const double& label, 
-      SparseVec &output) const;
+      double p, const Example &instance, const double& label, 
+      Gradient &output) const;
   double computeObjectiveGivenP(
-      double p, const SparseVec &instance, const double& label) const;
+      double p, const Example &instance, const double& label) const;
 
  private:
-  double computeP(const ParamVector &params, const SparseVec &instance) const;
-  const std::vector<SparseVec> *test_examples_;
+  double computeP(const ParamVector &params, const Example &instance) const;
+  const Examples *test_examples_;
   const std::vector<Label> *test_labels_;
 };
 
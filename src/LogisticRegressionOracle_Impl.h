@@ -7,31 +7,30 @@
 
 using namespace std;
 
-template<class ParamVector>
-double LogisticRegressionOracle<ParamVector>::computeP(
-    const ParamVector &params, const SparseVec &instance) const {
+template<class ParamVector, class Examples>
+double LogisticRegressionOracle<ParamVector, Examples>::computeP(
+    const ParamVector &params, const Example &instance) const {
   double dot = VectorUtils::sparseDot(instance, params);
   double p = 1.0 / (1.0 + exp(-dot));
   return p;
 }
 
-template<class ParamVector>
-double LogisticRegressionOracle<ParamVector>::computeObjectiveGivenP(
-    double p, const SparseVec &instance, const double& label) const {
+template<class ParamVector, class Examples>
+double LogisticRegressionOracle<ParamVector, Examples>::computeObjectiveGivenP(
+    double p, const Example &instance, const double& label) const {
   double output = -(label > 0.0 ?log(p) :log(1-p));
   return output;
 }
 
-template<class ParamVector>
-void LogisticRegressionOracle<ParamVector>::computeGradientGivenP(
-    double p, const SparseVec &instance, const double& label,
-    SparseVec &output) const {
-  output = instance;  
-  for(auto &x : output) {x.second *= p - label;}  
+template<class ParamVector, class Examples>
+void LogisticRegressionOracle<ParamVector, Examples>::computeGradientGivenP(
+    double p, const Example &instance, const double& label,
+    Gradient &output) const {
+  VectorUtils::scaledCopy(instance, p - label, output);
 }
 
-template<class ParamVector>
-void LogisticRegressionOracle<ParamVector>::evalParams(
+template<class ParamVector, class Examples>
+void LogisticRegressionOracle<ParamVector, Examples>::evalParams(
     const ParamVector &param_spec,    
     std::unordered_map<std::string, double> &output) const {
   if(test_examples_ == 0) {return;}
@@ -0,0 +1,154 @@
+#include "MappedDataset.h"
+
+#include <cmath>
+#include <cstring>
+#include <sys/mman.h>
+
+bool MappedBinaryDataset::open(const std::string &file_name,
+                               bool normalize_examples,
+                               const std::vector<double> *norms) {
+  if(!file_.open(file_name)) {return false;}
+  ASSERT(file_.size() >= BIN_HEADER_SIZE, "Invalid binary file " << file_name);
+
+  if(file_.size() >= sizeof(BIN_V2_MAGIC)
+     && memcmp(file_.data(), BIN_V2_MAGIC, sizeof(BIN_V2_MAGIC)) == 0) {
+    file_.close();
+    return false;
+  }
+
+  // Indexing touches every example header in order.
+  file_.advise(MADV_SEQUENTIAL);
+
+  const char *data = file_.data();
+  BinExampleCount num_examples;
+  memcpy(&num_examples, data, sizeof(num_examples));
+  memcpy(&num_features_, data + sizeof(num_examples), sizeof(num_features_));
+
+  LOG(num_examples << " " << num_features_);
+
+  offsets_.clear();
+  offsets_.reserve(num_examples + 1);
+  labels_.clear();
+  labels_.reserve(num_examples);
+  scales_.clear();
+  if(normalize_examples) {scales_.reserve(num_examples);}
+
+  size_t offset = BIN_HEADER_SIZE;
+
+  for(BinExampleCount i = 0; i < num_examples; ++i) {
+    ASSERT(offset + BIN_EXAMPLE_HEADER_SIZE <= file_.size(),
+           "Truncated binary file " << file_name);
+
+    BinLabel label = data[offset];
+    BinNZFeatCount num_nonzero;
+    memcpy(&num_nonzero, data + offset + sizeof(BinLabel),
+           sizeof(num_nonzero));
+
+    offsets_.push_back(offset);
+    labels_.push_back(label > 0 ?1.0 :0.0);
+    offset += BIN_EXAMPLE_HEADER_SIZE + num_nonzero * sizeof(BinEntry);
+
+    if(i % 1000000 == 0) LOG("Indexed " << i << " examples");
+  }
+
+  ASSERT(offset <= file_.size(), "Truncated binary file " << file_name);
+  offsets_.push_back(offset);
+
+  if(normalize_examples) {
+    ASSERT(norms == 0 || norms->size() == labels_.size(),
+           "Wrong number of example norms");
+
+    for(size_t i = 0; i < labels_.size(); ++i) {
+      BinSparseVecView view = (*this)[i];
+      double norm = 0.0;
+
+      if(norms != 0) {
+        norm = (*norms)[i];
+      } else {
+        for(BinNZFeatCount j = 0; j < view.num_nonzero; ++j) {
+          double value = view.entry(j).value;
+          norm += value * value;
+        }
+
+        norm = sqrt(norm);
+      }
+
+      scales_.push_back(norm == 0.0 ?1.0 :1.0 / norm);
+    }
+  }
+
+  file_.advise(MADV_NORMAL);
+  return true;
+}
+
+bool MappedBinaryV2Dataset::open(const std::string &file_name,
+                                 bool normalize_examples,
+                                 const std::vector<double> *norms) {
+  // Reads and validates the header and block index.
+  BinaryFileV2 file;
+  if(!file.open(file_name)) {return false;}
+  if(!file_.open(file_name)) {return false;}
+
+  const BinV2Header &header = file.header();
+  ASSERT(header.flags == 0, "Compressed file " << file_name
+         << " cannot be memory mapped, train without --mmap");
+  ASSERT(file_.size() >= (size_t) header.block_index_offset,
+         "Truncated binary file " << file_name);
+  num_features_ = header.num_features;
+  LOG(header.num_examples << " " << num_features_);
+
+  block_shift_ = 0;
+  while((1u << block_shift_) < header.examples_per_block) {++block_shift_;}
+  block_mask_ = header.examples_per_block - 1;
+
+  blocks_.resize(header.num_blocks);
+  labels_.resize(header.num_examples);
+  scales_.clear();
+  if(normalize_examples) {scales_.resize(header.num_examples);}
+  ASSERT(norms == 0 || (int64_t) norms->size() == header.num_examples,
+         "Wrong number of example norms");
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t b = 0; b < header.num_blocks; ++b) {
+    const BinV2BlockInfo &info = file.blockInfo(b);
+    const int64_t num_block_examples = file.blockNumExamples(b);
+    const int64_t start = file.blockStart(b);
+    BinV2BlockLayout layout(num_block_examples, info);
+    ASSERT(info.offset + layout.size <= (size_t) header.block_index_offset,
+           "Invalid block " << b << " in " << file_name);
+
+    const char *data = file_.data() + info.offset;
+    Block &block = blocks_[b];
+    block.row_offsets = reinterpret_cast<const int64_t *>(
+        data + layout.row_offsets);
+    block.indices = reinterpret_cast<const int *>(data + layout.indices);
+    block.values = reinterpret_cast<const float *>(data + layout.values);
+
+    const float *labels = reinterpret_cast<const float *>(data + layout.labels);
+    for(int64_t i = 0; i < num_block_examples; ++i) {
+      labels_[start + i] = labels[i] > 0 ?1.0 :0.0;
+    }
+
+    if(normalize_examples) {
+      for(int64_t i = 0; i < num_block_examples; ++i) {
+        double norm = 0.0;
+
+        if(norms != 0) {
+          norm = (*norms)[start + i];
+        } else {
+          for(int64_t j = block.row_offsets[i]; j < block.row_offsets[i+1];
+              ++j) {
+            double value = block.values[j];
+            norm += value * value;
+          }
+
+          norm = sqrt(norm);
+        }
+
+        scales_[start + i] = norm == 0.0 ?1.0 :1.0 / norm;
+      }
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,166 @@
+#ifndef _SVRG_MAPPEDDATASET_H_
+#define _SVRG_MAPPEDDATASET_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BinaryFormat.h"
+#include "CSRDataset.h"
+#include "DataReader.h"
+#include "MappedFile.h"
+#include "Vector.h"
+
+// Read-only view of an example stored in a memory mapped binary file.
+// Values are multiplied by 'scale' on access, which allows normalizing
+// examples without writing to the mapped pages.
+//
+// Entries follow the file and example headers without padding, so they are
+// not aligned: they are copied out with memcpy rather than dereferenced,
+// which compilers turn into plain loads where unaligned loads are allowed.
+struct BinSparseVecView {
+  typedef SparseExample::Index Index;
+
+  const char *entries;
+  BinNZFeatCount num_nonzero;
+  double scale;
+
+  size_t size() const {return num_nonzero;}
+
+  BinEntry entry(size_t k) const {
+    BinEntry entry;
+    memcpy(&entry, entries + k * sizeof(BinEntry), sizeof(BinEntry));
+    return entry;
+  }
+};
+
+template<>
+class VectorIterator<BinSparseVecView> {
+ public:
+  VectorIterator(const BinSparseVecView &vector)
+      : iterator_(vector.entries),
+        end_iterator_(vector.entries + vector.num_nonzero * sizeof(BinEntry)),
+        scale_(vector.scale) {}
+
+  int index() const {
+    SparseExample::Index index;
+    memcpy(&index, iterator_ + offsetof(BinEntry, index), sizeof(index));
+    return index;
+  }
+
+  double value() const {
+    float value;
+    memcpy(&value, iterator_ + offsetof(BinEntry, value), sizeof(value));
+    return scale_ * value;
+  }
+
+  operator bool() const {return iterator_ != end_iterator_;}
+  void next() {iterator_ += sizeof(BinEntry);}
+
+ private:
+  const char *iterator_;
+  const char *end_iterator_;
+  double scale_;
+};
+
+// A training set backed by a memory mapped binary file (see svm2bin).
+// Examples are accessed in place; only labels, per-example offsets and
+// normalization factors are kept in process memory.
+class MappedBinaryDataset {
+ public:
+  typedef BinSparseVecView value_type;
+
+  MappedBinaryDataset() {}
+  MappedBinaryDataset(const MappedBinaryDataset &) = delete;
+  MappedBinaryDataset &operator=(const MappedBinaryDataset &) = delete;
+
+  // Maps the file and indexes its examples. Labels are converted to 0/1.
+  // Returns false if the file cannot be mapped or is a version 2 file.
+  // If norms are given (see DatasetStats), they are used to normalize
+  // examples instead of reading every example.
+  bool open(const std::string &file_name, bool normalize_examples,
+            const std::vector<double> *norms = 0);
+
+  size_t size() const {return labels_.size();}
+  int num_features() const {return num_features_;}
+  const std::vector<double> &labels() const {return labels_;}
+
+  BinSparseVecView operator[](size_t i) const {
+    BinSparseVecView view;
+    size_t offset = offsets_[i];
+    view.entries = file_.data() + offset + BIN_EXAMPLE_HEADER_SIZE;
+    view.num_nonzero = (offsets_[i+1] - offset - BIN_EXAMPLE_HEADER_SIZE)
+        / sizeof(BinEntry);
+    view.scale = scales_.empty() ?1.0 :scales_[i];
+    return view;
+  }
+
+ private:
+  MappedFile file_;
+  int num_features_ = 0;
+
+  // File offset of each example followed by the size of the file.
+  std::vector<size_t> offsets_;
+  std::vector<double> labels_;
+
+  // Per-example normalization factors. Empty if examples are not normalized.
+  std::vector<double> scales_;
+};
+
+// A training set backed by a memory mapped version 2 binary file
+// (see BinaryFormat.h). Blocks already store examples in CSR format, so only
+// labels, normalization factors and a pointer per block section are kept in
+// process memory. Block checksums are not verified.
+class MappedBinaryV2Dataset {
+ public:
+  typedef CSRRowView value_type;
+
+  MappedBinaryV2Dataset() {}
+  MappedBinaryV2Dataset(const MappedBinaryV2Dataset &) = delete;
+  MappedBinaryV2Dataset &operator=(const MappedBinaryV2Dataset &) = delete;
+
+  // Maps the file and reads its labels. Labels are converted to 0/1.
+  // Returns false if the file cannot be mapped or is not a version 2 file.
+  // Norms are used as in MappedBinaryDataset::open.
+  bool open(const std::string &file_name, bool normalize_examples,
+            const std::vector<double> *norms = 0);
+
+  size_t size() const {return labels_.size();}
+  int num_features() const {return num_features_;}
+  const std::vector<double> &labels() const {return labels_;}
+
+  CSRRowView operator[](size_t i) const {
+    const Block &block = blocks_[i >> block_shift_];
+    size_t j = i & block_mask_;
+    CSRRowView view;
+    int64_t start = block.row_offsets[j];
+    view.indices = block.indices + start;
+    view.values = block.values + start;
+    view.num_nonzero = block.row_offsets[j+1] - start;
+    view.scale = scales_.empty() ?1.0 :scales_[i];
+    return view;
+  }
+
+ private:
+  struct Block {
+    const int64_t *row_offsets;
+    const int *indices;
+    const float *values;
+  };
+
+  MappedFile file_;
+  int num_features_ = 0;
+
+  // Example i is the (i & block_mask_)-th example of block i >> block_shift_.
+  int block_shift_ = 0;
+  size_t block_mask_ = 0;
+  std::vector<Block> blocks_;
+
+  std::vector<double> labels_;
+
+  // Per-example normalization factors. Empty if examples are not normalized.
+  std::vector<double> scales_;
+};
+
+#endif
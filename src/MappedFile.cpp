@@ -0,0 +1,40 @@
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string &file_name) {
+  if(data_ != 0) {close();}
+
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if(fd < 0) {return false;}
+
+  struct stat file_stat;
+  if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(0, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping remains valid after closing the descriptor.
+  ::close(fd);
+
+  if(data == MAP_FAILED) {return false;}
+
+  data_ = static_cast<const char *>(data);
+  size_ = file_stat.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  ASSERT(data_ != 0, "MappedFile already closed");
+  munmap(const_cast<char *>(data_), size_);
+  data_ = 0;
+  size_ = 0;
+}
+
+void MappedFile::advise(int advice) const {
+  madvise(const_cast<char *>(data_), size_, advice);
+}
@@ -0,0 +1,32 @@
+#ifndef _SVRG_MAPPEDFILE_H_
+#define _SVRG_MAPPEDFILE_H_
+
+#include <string>
+
+// Read-only memory mapping of an entire file.
+// The mapping is shared, so processes that map the same file use a single
+// copy of its contents in the page cache.
+class MappedFile {
+ public:
+  MappedFile() {}
+  ~MappedFile() {if(data_ != 0) {close();}}
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Maps the file. Returns false if the file cannot be opened or mapped.
+  bool open(const std::string &file_name);
+  void close();
+
+  // Passes an access pattern hint (e.g. MADV_SEQUENTIAL) to the kernel.
+  void advise(int advice) const;
+
+  const char *data() const {return data_;}
+  size_t size() const {return size_;}
+
+ private:
+  const char *data_ = 0;
+  size_t size_ = 0;
+};
+
+#endif
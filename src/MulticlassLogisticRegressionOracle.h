@@ -0,0 +1,97 @@
+#ifndef SVRG_MULTICLASS_LOGISTIC_REGRESSION_ORACLE_
+#define SVRG_MULTICLASS_LOGISTIC_REGRESSION_ORACLE_
+
+#include "Oracle.h"
+#include "PerThread.h"
+
+// One-vs-rest logistic regression for K classes: the objective is the sum of
+// the K binary objectives of LogisticRegressionOracle, where the positive
+// examples of class c are those labeled c.
+//
+// The K weight vectors are interleaved by feature, i.e. the weight of
+// feature f for class c is at index f * K + c of the parameter vector. All
+// classes are then updated from a single pass over each example, and the
+// weights of one feature for all classes share cache lines. Gradients hold K
+// consecutive entries for every non-zero feature of the example.
+//
+// Labels are class ids in [0, K) (see toClassIds). Test examples may have
+// other labels, which always count as mistakes.
+template<class ParamVector, class Examples = std::vector<SparseVec>>
+class MulticlassLogisticRegressionOracle
+    : public Oracle<ParamVector, SparseGradient<ParamVector>> {
+ public:
+  typedef SparseGradient<ParamVector> Gradient;
+  typedef double Label;
+  typedef typename Examples::value_type Example;
+
+  MulticlassLogisticRegressionOracle(
+      const Examples *examples, const std::vector<Label> *labels,
+      int num_features, int num_classes, double l2_reg,
+      const Examples *test_examples = 0,
+      const std::vector<Label> *test_labels = 0,
+      const std::vector<int> *feature_counts = 0);
+
+  const Gradient *getInstance(int instance) const override {
+    ASSERT(false, "Not supported");
+    return 0;
+  }
+
+  void computeGradient(const ParamVector &params, int instance,
+                       Gradient &output) const override {
+    computeObjAndGradient(params, instance, output, false);
+  }
+
+  double computeObjective(const ParamVector &params,
+                          int instance) const override;
+
+  double computeObjAndGradient(const ParamVector &params, int instance,
+                               Gradient &out_gradient) const override {
+    return computeObjAndGradient(params, instance, out_gradient, true);
+  }
+
+  int getNumInstances() const override {return examples_->size();}
+  int getDimension() const override {return num_features_ * num_classes_;}
+
+  void evalParams(
+      const ParamVector &x,
+      std::unordered_map<std::string, double> &output) const override;
+
+  int num_classes() const {return num_classes_;}
+
+ private:
+  // Sets margins[c] to the dot product of the example and the weights of
+  // class c.
+  void computeMargins(const ParamVector &params, const Example &instance,
+                      double *margins) const;
+
+  double computeObjAndGradient(const ParamVector &params, int instance,
+                               Gradient &output, bool objective) const;
+
+  int num_features_;
+  int num_classes_;
+  double l2_reg_;
+
+  // For each feature, stores number of examples where the feature
+  // is not zero
+  std::vector<int> feature_counts_;
+  const Examples *examples_;
+  const std::vector<Label> *labels_;
+  const Examples *test_examples_;
+  const std::vector<Label> *test_labels_;
+
+  // K margins per thread.
+  mutable PerThread<std::vector<double>> margins_;
+};
+
+// Returns the distinct values of labels in increasing order. Class c of a
+// multiclass oracle stands for the c-th value.
+std::vector<double> distinctLabels(const std::vector<double> &labels);
+
+// Replaces each label by its position in classes, or -1 if it is not one of
+// the classes.
+void toClassIds(const std::vector<double> &classes,
+                std::vector<double> *labels);
+
+#include "MulticlassLogisticRegressionOracle_Impl.h"
+
+#endif
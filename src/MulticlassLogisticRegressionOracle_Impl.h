@@ -0,0 +1,162 @@
+#include "MulticlassLogisticRegressionOracle.h"
+
+#include <algorithm>
+#include <cmath>
+
+template<class ParamVector, class Examples>
+MulticlassLogisticRegressionOracle<ParamVector, Examples>::
+MulticlassLogisticRegressionOracle(
+    const Examples *examples, const std::vector<Label> *labels,
+    int num_features, int num_classes, double l2_reg,
+    const Examples *test_examples, const std::vector<Label> *test_labels,
+    const std::vector<int> *feature_counts)
+    : num_features_(num_features), num_classes_(num_classes),
+      l2_reg_(l2_reg), feature_counts_(num_features), examples_(examples),
+      labels_(labels), test_examples_(test_examples),
+      test_labels_(test_labels),
+      margins_(std::vector<double>(num_classes)) {
+  ASSERT(num_classes > 0, "Invalid number of classes");
+
+  if(feature_counts != 0) {
+    ASSERT(feature_counts->size() == (size_t) num_features,
+           "Invalid feature counts");
+    feature_counts_ = *feature_counts;
+    return;
+  }
+
+  for(size_t i = 0; i < examples->size(); ++i) {
+    const Example &example = (*examples)[i];
+    VectorIterator<Example> iterator(example);
+
+    for(; iterator; iterator.next()) {
+      ++feature_counts_[iterator.index()];
+    }
+  }
+}
+
+template<class ParamVector, class Examples>
+void MulticlassLogisticRegressionOracle<ParamVector, Examples>::computeMargins(
+    const ParamVector &params, const Example &instance,
+    double *margins) const {
+  std::fill(margins, margins + num_classes_, 0.0);
+  VectorIterator<Example> iterator(instance);
+
+  for(; iterator; iterator.next()) {
+    const size_t base = iterator.index() * num_classes_;
+    const double value = iterator.value();
+
+    for(int c = 0; c < num_classes_; ++c) {
+      margins[c] += value * params[base + c];
+    }
+  }
+}
+
+template<class ParamVector, class Examples>
+double MulticlassLogisticRegressionOracle<ParamVector, Examples>::
+computeObjective(const ParamVector &params, int instance_id) const {
+  const Example &instance = (*examples_)[instance_id];
+  const int label = (*labels_)[instance_id];
+  std::vector<double> &margins = margins_.local();
+  computeMargins(params, instance, margins.data());
+
+  double obj = 0.0;
+
+  for(int c = 0; c < num_classes_; ++c) {
+    double p = 1.0 / (1.0 + exp(-margins[c]));
+    obj -= (c == label) ?log(p) :log(1-p);
+  }
+
+  // Add regularization
+  VectorIterator<Example> iterator(instance);
+
+  for(; iterator; iterator.next()) {
+    const size_t base = iterator.index() * num_classes_;
+    const double scale = l2_reg_ / feature_counts_[iterator.index()];
+
+    for(int c = 0; c < num_classes_; ++c) {
+      double x = params[base + c];
+      obj += scale * x * x;
+    }
+  }
+
+  return obj;
+}
+
+template<class ParamVector, class Examples>
+double MulticlassLogisticRegressionOracle<ParamVector, Examples>::
+computeObjAndGradient(const ParamVector &params, int instance_id,
+                      Gradient &output, bool objective) const {
+  const Example &instance = (*examples_)[instance_id];
+  const int label = (*labels_)[instance_id];
+
+  // Margins, then the derivative of the loss of each class w.r.t. its margin.
+  std::vector<double> &residuals = margins_.local();
+  computeMargins(params, instance, residuals.data());
+
+  double obj = 0.0;
+
+  for(int c = 0; c < num_classes_; ++c) {
+    double p = 1.0 / (1.0 + exp(-residuals[c]));
+    if(objective) {obj -= (c == label) ?log(p) :log(1-p);}
+    residuals[c] = p - (c == label ?1.0 :0.0);
+  }
+
+  output.clear();
+  output.reserve(instance.size() * num_classes_);
+  VectorIterator<Example> iterator(instance);
+
+  for(; iterator; iterator.next()) {
+    const size_t base = iterator.index() * num_classes_;
+    const double value = iterator.value();
+    const double scale = l2_reg_ / feature_counts_[iterator.index()];
+
+    // Add regularization
+    for(int c = 0; c < num_classes_; ++c) {
+      double x = params[base + c];
+      output.addElement(base + c, residuals[c] * value + 2 * scale * x);
+      if(objective) {obj += scale * x * x;}
+    }
+  }
+
+  return obj;
+}
+
+template<class ParamVector, class Examples>
+void MulticlassLogisticRegressionOracle<ParamVector, Examples>::evalParams(
+    const ParamVector &param_spec,
+    std::unordered_map<std::string, double> &output) const {
+  if(test_examples_ == 0) {return;}
+
+  int n_test = test_examples_->size();
+  int num_mistakes = 0;
+
+#pragma omp parallel
+  {
+    std::vector<double> &margins = margins_.local();
+
+#pragma omp for reduction(+:num_mistakes)
+    for(int i = 0; i < n_test; ++i) {
+      computeMargins(param_spec, (*test_examples_)[i], margins.data());
+      int prediction = std::max_element(margins.begin(), margins.end())
+          - margins.begin();
+      num_mistakes += (prediction != (*test_labels_)[i]) ?1 :0;
+    }
+  }
+
+  output["test_error"] = static_cast<double>(num_mistakes) / n_test;
+}
+
+inline std::vector<double> distinctLabels(const std::vector<double> &labels) {
+  std::vector<double> classes(labels);
+  std::sort(classes.begin(), classes.end());
+  classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+  return classes;
+}
+
+inline void toClassIds(const std::vector<double> &classes,
+                       std::vector<double> *labels) {
+  for(double &label : *labels) {
+    auto it = std::lower_bound(classes.begin(), classes.end(), label);
+    label = (it != classes.end() && *it == label) ?it - classes.begin() :-1;
+  }
+}
@@ -0,0 +1,120 @@
+#include "Numa.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Platform.h"
+
+// From linux/mempolicy.h
+static const int MPOL_BIND_MODE = 2;
+static const int MPOL_INTERLEAVE_MODE = 3;
+static const unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+
+// Parses a sysfs CPU list such as "0-3,8-11".
+static std::vector<int> parseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+
+  while(std::getline(stream, range, ',')) {
+    if(range.empty() || range == "\n") {continue;}
+    size_t dash = range.find('-');
+    int first = atoi(range.c_str());
+    int last = (dash == std::string::npos) ?first
+        :atoi(range.c_str() + dash + 1);
+    for(int cpu = first; cpu <= last; ++cpu) {cpus.push_back(cpu);}
+  }
+
+  return cpus;
+}
+
+const std::vector<std::vector<int>> &Numa::nodeCpus() {
+  static const std::vector<std::vector<int>> node_cpus = [] {
+    std::vector<std::vector<int>> cpus;
+
+    for(int node = 0; ; ++node) {
+      std::ifstream file("/sys/devices/system/node/node"
+                         + std::to_string(node) + "/cpulist");
+      if(!file) {break;}
+      std::string list;
+      std::getline(file, list);
+      cpus.push_back(parseCpuList(list));
+    }
+
+    return cpus;
+  }();
+
+  return node_cpus;
+}
+
+int Numa::numNodes() {
+  return std::max<int>(nodeCpus().size(), 1);
+}
+
+int Numa::nodeOfThread(int thread_id, int num_threads) {
+  return static_cast<int64_t>(thread_id) * numNodes() / num_threads;
+}
+
+bool Numa::pinThreads() {
+  const std::vector<std::vector<int>> &node_cpus = nodeCpus();
+  if(node_cpus.empty()) {return false;}
+  const int num_threads = Platform::getNumLocalThreads();
+  int num_pinned = 0;
+
+  #pragma omp parallel num_threads(num_threads) reduction(+:num_pinned)
+  {
+    const int thread_id = Platform::getThreadId();
+    const std::vector<int> &cpus =
+        node_cpus[nodeOfThread(thread_id, num_threads)];
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for(int cpu : cpus) {CPU_SET(cpu, &cpu_set);}
+    if(!cpus.empty()
+       && sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+      ++num_pinned;
+    }
+  }
+
+  return num_pinned == num_threads;
+}
+
+// Applies a memory policy to the whole pages of [begin, begin + size).
+static bool setPolicy(const void *begin, size_t size, int mode,
+                      const std::vector<unsigned long> &node_mask) {
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page_size - 1)
+      & ~(page_size - 1);
+  const uintptr_t last = (reinterpret_cast<uintptr_t>(begin) + size)
+      & ~(page_size - 1);
+  if(last <= first) {return true;}
+
+  return syscall(SYS_mbind, first, last - first, mode, node_mask.data(),
+                 node_mask.size() * 8 * sizeof(unsigned long),
+                 MPOL_MF_MOVE_FLAG) == 0;
+}
+
+static std::vector<unsigned long> nodeMask(int first, int last) {
+  const int bits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(last / bits + 1, 0);
+  for(int node = first; node <= last; ++node) {
+    mask[node / bits] |= 1ul << (node % bits);
+  }
+  return mask;
+}
+
+bool Numa::interleave(const void *begin, size_t size) {
+  return setPolicy(begin, size, MPOL_INTERLEAVE_MODE,
+                   nodeMask(0, numNodes() - 1));
+}
+
+bool Numa::bind(const void *begin, size_t size, int node) {
+  return setPolicy(begin, size, MPOL_BIND_MODE, nodeMask(node, node));
+}
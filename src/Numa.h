@@ -0,0 +1,56 @@
+#ifndef _SVRG_NUMA_H_
+#define _SVRG_NUMA_H_
+
+#include <cstddef>
+#include <vector>
+
+// Placement of threads and memory on NUMA nodes (Linux only, through
+// sysfs and the mbind system call, so that libnuma is not needed).
+//
+// Threads of the OpenMP team are assigned to nodes in contiguous blocks of
+// thread ids, e.g. with 2 nodes and 8 threads, threads 0-3 run on node 0 and
+// threads 4-7 on node 1. Static schedules then give each node a contiguous
+// range of iterations.
+//
+// Memory policies only apply to pages that are not touched yet, or are
+// moved if they are. Partial pages at both ends of a range keep their
+// placement. All functions do nothing useful but are safe on machines with
+// a single node.
+class Numa {
+ public:
+  static int numNodes();
+
+  // The node of a thread of a team of num_threads threads.
+  static int nodeOfThread(int thread_id, int num_threads);
+
+  // Pins each thread of the current OpenMP team size (see
+  // Platform::getNumLocalThreads) to the CPUs of its node. Returns false if
+  // the CPUs of the nodes are unknown or a thread could not be pinned.
+  static bool pinThreads();
+
+  // Spreads the pages of a range over all nodes.
+  static bool interleave(const void *begin, size_t size);
+
+  // Places the pages of a range on one node.
+  static bool bind(const void *begin, size_t size, int node);
+
+  // Resizes an empty vector to 'size' zeros whose pages are interleaved (or
+  // on 'node' if it is not negative). The policy is set before the pages
+  // are first touched.
+  template<class Vector>
+  static void allocate(Vector *vector, size_t size, int node = -1) {
+    vector->clear();
+    vector->shrink_to_fit();
+    vector->reserve(size);
+    const size_t bytes = size * sizeof(typename Vector::value_type);
+    if(node < 0) {interleave(vector->data(), bytes);}
+    else {bind(vector->data(), bytes, node);}
+    vector->resize(size);
+  }
+
+ private:
+  // CPUs of each node, read once from sysfs.
+  static const std::vector<std::vector<int>> &nodeCpus();
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define _SVRG_ORACLE_H_
 
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -11,6 +12,8 @@
 template<class ParamVector, class Gradient>
 class Oracle {
  public:	
+  typedef BasicVector<typename ParamVector::value_type> DenseVector;
+
   virtual ~Oracle() {}
 
   virtual void computeGradient(const ParamVector &params, int instance, Gradient &output) const = 0;
@@ -28,19 +31,105 @@ class Oracle {
 
   //TODO: This is a temp fix for SAGA
   virtual const Gradient *getInstance(int instance) const = 0;  
+
+  // Oracles of generalized linear models, whose loss on an instance only
+  // depends on the dot product of the instance and the parameters, return
+  // true. The gradient on an instance is then the instance times a scale
+  // (the derivative of the loss w.r.t. the dot product) plus the
+  // regularization of its features, and solvers can apply updates straight
+  // from the instance with the methods below instead of computing a
+  // Gradient.
+  virtual bool hasScaledGradients() const {return false;}
+
+  // Returns the scale of the gradient of an instance at params.
+  virtual double computeGradientScale(const ParamVector &params,
+                                      int instance) const {
+    ASSERT(false, "Not supported");
+    return 0.0;
+  }
+
+  // Computes the scales at params and last_params. Oracles compute both
+  // dot products in a single pass over the instance.
+  virtual void computeGradientScales(const ParamVector &params,
+                                     const ParamVector &last_params,
+                                     int instance, double *scale,
+                                     double *last_scale) const {
+    *scale = computeGradientScale(params, instance);
+    *last_scale = computeGradientScale(last_params, instance);
+  }
+
+  // Computes v := v + step * g, where g is the gradient of an instance at
+  // params and scale = computeGradientScale(params, instance).
+  virtual void addScaledGradient(int instance, const ParamVector &params,
+                                 double scale, double step, DenseVector &v,
+                                 bool atomic) const {
+    ASSERT(false, "Not supported");
+  }
+
+  // Same as above with the difference of the gradients at params and
+  // last_params (e.g. SVRG's variance-reduced direction).
+  virtual void addScaledGradientDifference(
+      int instance, const ParamVector &params, double scale,
+      const ParamVector &last_params, double last_scale, double step,
+      DenseVector &v, bool atomic) const {
+    ASSERT(false, "Not supported");
+  }
 };
 
-template<class ParamVector, class Label = double>
-class SparseExampleOracle : public Oracle<ParamVector, SparseVec> {
+// Sparse gradients have the value type of the parameters (e.g. float
+// gradients for float parameters). Oracles still compute each value in
+// double precision.
+template<class ParamVector>
+using SparseGradient = BasicSparseVec<typename ParamVector::value_type>;
+
+// Returns a pointer to an example that is stored as a Gradient.
+// Other example representations (e.g. views into a mapped file or double
+// examples with float gradients) cannot be returned as a gradient.
+template<class Gradient, class Example>
+const Gradient *asGradientPtr(const Example &example) {
+  ASSERT((std::is_same<Gradient, Example>::value), "Not supported");
+  return reinterpret_cast<const Gradient *>(&example);
+}
+
+// An oracle for objectives that are sums of losses on sparse examples.
+// Examples can be any random access container (std::vector<SparseVec>,
+// MappedBinaryDataset ... etc.) whose elements support VectorIterator.
+//
+// The loss is implemented by Derived (CRTP) through the do*() hooks below,
+// which are called without virtual dispatch. If Derived is final, solvers
+// instantiated on it (see BasicSGDSolver::solveWith) call the oracle
+// without virtual dispatch as well, so that the loss, regularization and
+// update loops can be inlined together. The Oracle interface remains
+// available for solvers that take any oracle.
+template<class Derived, class ParamVector, class Label = double,
+         class Examples = std::vector<SparseVec>>
+class SparseExampleOracle
+    : public Oracle<ParamVector, SparseGradient<ParamVector>> {
  public:
-  typedef SparseVec Gradient;
-  SparseExampleOracle(const std::vector<SparseVec> *examples,
+  typedef SparseGradient<ParamVector> Gradient;
+  typedef typename Examples::value_type Example;
+  typedef typename ParamVector::value_type Real;
+  typedef BasicVector<Real> DenseVector;
+
+  // If feature_counts is given, it is used instead of counting non-zero
+  // features over examples (e.g. when examples only hold a window of the
+  // training set, see ExampleStream).
+  SparseExampleOracle(const Examples *examples,
                       const std::vector<Label> *labels, int num_features,
-                      double l2_reg)
+                      double l2_reg,
+                      const std::vector<int> *feature_counts = 0)
       : examples_(examples), labels_(labels), num_features_(num_features),
         l2_reg_(l2_reg), feature_counts_(num_features_) {
-    for(const auto &example : *examples) {
-      VectorIterator<SparseVec> iterator(example);
+    if(feature_counts != 0) {
+      ASSERT(feature_counts->size() == (size_t) num_features,
+             "Invalid feature counts");
+      feature_counts_ = *feature_counts;
+      return;
+    }
+
+    for(size_t i = 0; i < examples->size(); ++i) {
+      const Example &example = (*examples)[i];
+      VectorIterator<Example> iterator(example);
 
       for(; iterator; iterator.next()) {
         ++feature_counts_[iterator.index()];
@@ -49,22 +138,23 @@ class SparseExampleOracle : public Oracle<ParamVector, SparseVec> {
   }
 
   const Gradient *getInstance(int instance) const final {
-    return &(*examples_)[instance];
+    return asGradientPtr<Gradient>((*examples_)[instance]);
   }
 
   void computeGradient(const ParamVector &params, int instance_id, Gradient &output) const final {
-    const SparseVec &instance = (*examples_)[instance_id];
-    doComputeGradient(params, (*examples_)[instance_id], (*labels_)[instance_id], output);
+    const Example &instance = (*examples_)[instance_id];
+    derived().doComputeGradient(params, instance, (*labels_)[instance_id],
+                                output);
 
     // Add regularization
-    VectorIterator<SparseVec> instance_iterator(instance);
-    ModifyingVectorIterator<SparseVec> grad_iterator(output);
+    VectorIterator<Example> instance_iterator(instance);
+    ModifyingVectorIterator<Gradient> grad_iterator(output);
 
     for(; instance_iterator; instance_iterator.next(), grad_iterator.next()) {
       ASSERT(grad_iterator, "");
-      ASSERT(instance_iterator.index() == grad_iterator.index(), "");
-
       int idx = instance_iterator.index();
+      ASSERT(idx == (int) grad_iterator.index(), "");
+
       double x = params[idx];
 
       grad_iterator.valueRef() += 2 * l2_reg_ * x / feature_counts_[idx];
@@ -74,11 +164,12 @@ class SparseExampleOracle : public Oracle<ParamVector, SparseVec> {
   }
 
   double computeObjective(const ParamVector &params, int instance_id) const final {
-    const SparseVec &instance = (*examples_)[instance_id];
-    double obj = doComputeObjective(params, instance, (*labels_)[instance_id]);
+    const Example &instance = (*examples_)[instance_id];
+    double obj = derived().doComputeObjective(params, instance,
+                                              (*labels_)[instance_id]);
 
     // Add regularization
-    VectorIterator<SparseVec> instance_iterator(instance);
+    VectorIterator<Example> instance_iterator(instance);
 
     for(; instance_iterator; instance_iterator.next()) {
       int idx = instance_iterator.index();
@@ -91,19 +182,19 @@ class SparseExampleOracle : public Oracle<ParamVector, SparseVec> {
   }
 
   double computeObjAndGradient(const ParamVector &params, int instance_id, Gradient &out_gradient) const final {
-    const SparseVec &instance = (*examples_)[instance_id];
-    double obj = doComputeObjAndGradient(params, instance,
-                                         (*labels_)[instance_id], out_gradient);
+    const Example &instance = (*examples_)[instance_id];
+    double obj = derived().doComputeObjAndGradient(
+        params, instance, (*labels_)[instance_id], out_gradient);
 
     // Add regularization
-    VectorIterator<SparseVec> instance_iterator(instance);
-    ModifyingVectorIterator<SparseVec> grad_iterator(out_gradient);
+    VectorIterator<Example> instance_iterator(instance);
+    ModifyingVectorIterator<Gradient> grad_iterator(out_gradient);
 
     for(; instance_iterator; instance_iterator.next(), grad_iterator.next()) {
       ASSERT(grad_iterator, "");
-      ASSERT(instance_iterator.index() == grad_iterator.index(), "");
-
       int idx = instance_iterator.index();
+      ASSERT(idx == (int) grad_iterator.index(), "");
+
       double x = params[idx];
       
       grad_iterator.valueRef() += 2 * l2_reg_ * x / feature_counts_[idx];
@@ -115,32 +206,103 @@ class SparseExampleOracle : public Oracle<ParamVector, SparseVec> {
     return obj;
   }
 
+  double computeGradientScale(const ParamVector &params,
+                              int instance_id) const final {
+    double margin = VectorUtils::sparseDot((*examples_)[instance_id], params);
+    return derived().computeScaleGivenMargin(margin, (*labels_)[instance_id]);
+  }
+
+  void computeGradientScales(const ParamVector &params,
+                             const ParamVector &last_params, int instance_id,
+                             double *scale, double *last_scale) const final {
+    double margin, last_margin;
+    VectorUtils::sparseDots((*examples_)[instance_id], params, last_params,
+                            &margin, &last_margin);
+    const Label &label = (*labels_)[instance_id];
+    *scale = derived().computeScaleGivenMargin(margin, label);
+    *last_scale = derived().computeScaleGivenMargin(last_margin, label);
+  }
+
+  // The gradient values are rounded to Real as in computeGradient, so that
+  // updates are the same as with materialized gradients.
+  void addScaledGradient(int instance_id, const ParamVector &params,
+                         double scale, double step, DenseVector &v,
+                         bool atomic) const final {
+    Real *raw = v.data();
+    VectorIterator<Example> iterator((*examples_)[instance_id]);
+
+    for(; iterator; iterator.next()) {
+      int idx = iterator.index();
+      Real g = iterator.value() * scale;
+      g += 2 * l2_reg_ * params[idx] / feature_counts_[idx];
+
+      if(atomic) {Platform::atomicAdd(raw + idx, g * step);}
+      else {raw[idx] += g * step;}
+    }
+  }
+
+  void addScaledGradientDifference(
+      int instance_id, const ParamVector &params, double scale,
+      const ParamVector &last_params, double last_scale, double step,
+      DenseVector &v, bool atomic) const final {
+    Real *raw = v.data();
+    VectorIterator<Example> iterator((*examples_)[instance_id]);
+
+    for(; iterator; iterator.next()) {
+      int idx = iterator.index();
+      double value = iterator.value();
+      Real g = value * scale;
+      g += 2 * l2_reg_ * params[idx] / feature_counts_[idx];
+      Real last_g = value * last_scale;
+      last_g += 2 * l2_reg_ * last_params[idx] / feature_counts_[idx];
+      g -= last_g;
+
+      if(atomic) {Platform::atomicAdd(raw + idx, g * step);}
+      else {raw[idx] += g * step;}
+    }
+  }
+
   int getNumInstances() const override {return examples_->size();}
   int getDimension() const override {return num_features_;}
 
  protected:
-  virtual void doComputeGradient(const ParamVector &params,
-                                 const SparseVec &instance, const Label& label,
-                                 Gradient &output) const = 0;
-  virtual double doComputeObjective(const ParamVector &params,
-                                    const SparseVec &instance,
-                                    const Label& label) const = 0;
-  virtual double doComputeObjAndGradient(
-      const ParamVector &params, const SparseVec &instance,
+  // Hooks that Derived must define (hiding the defaults for the last two):
+  //
+  //   void doComputeGradient(const ParamVector &params,
+  //                          const Example &instance, const Label& label,
+  //                          Gradient &output) const;
+  //   double doComputeObjective(const ParamVector &params,
+  //                             const Example &instance,
+  //                             const Label& label) const;
+
+  double doComputeObjAndGradient(
+      const ParamVector &params, const Example &instance,
       const Label& label, Gradient &out_gradient) const {
-    doComputeGradient(params, instance, label, out_gradient);
-    return doComputeObjective(params, instance, label);
+    derived().doComputeGradient(params, instance, label, out_gradient);
+    return derived().doComputeObjective(params, instance, label);
+  }
+
+  // Returns the derivative of the loss w.r.t. the dot product of an
+  // instance and the parameters. Required if hasScaledGradients() returns
+  // true.
+  double computeScaleGivenMargin(double margin, const Label& label) const {
+    ASSERT(false, "Not supported");
+    return 0.0;
   }
 
  private:
+  const Derived &derived() const {
+    return static_cast<const Derived &>(*this);
+  }
+
   int num_features_;
   double l2_reg_;
 
   // For each feature, stores number of examples where the feature
   // is not zero
   std::vector<int> feature_counts_;
-  const std::vector<SparseVec> *examples_;
-  const std::vector<double> *labels_;
+  const Examples *examples_;
+  const std::vector<Label> *labels_;
 };
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef _SVRG_PER_THREAD_H_
+#define _SVRG_PER_THREAD_H_
+
+#include <vector>
+
+#include "Platform.h"
+
+// One object of type T per local thread (see Platform::getThreadId), e.g.
+// scratch vectors that are cleared and refilled for every example. Objects
+// keep their memory between uses, so that once they reached their largest
+// size, using them does not allocate. Objects are padded so that threads
+// do not write to the same cache line.
+template<class T>
+class PerThread {
+ public:
+  explicit PerThread(const T &value = T())
+      : items_(Platform::getNumLocalThreads(), Item(value)) {}
+
+  // The object of the calling thread.
+  T &local() {return items_[Platform::getThreadId()].value;}
+
+  T &operator[](int thread_id) {return items_[thread_id].value;}
+  int size() const {return items_.size();}
+
+ private:
+  static constexpr int CACHE_LINE_SIZE = 64;
+
+  struct Item {
+    Item(const T &value) : value(value), padding() {}
+
+    T value;
+    char padding[CACHE_LINE_SIZE];
+  };
+
+  std::vector<Item> items_;
+};
+
+#endif
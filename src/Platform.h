@@ -56,7 +56,21 @@ class Platform {
          ,"+x"(increment)
         :
         :"cc", "xmm0", "rax", "rdx");
-  }  
+  }
+
+  inline static void atomicAdd(volatile float *var, float increment) {
+    __asm__ __volatile__ (
+        "1: movss %0,%%xmm0\n\t"
+        "movd %%xmm0,%%eax\n\t"
+        "addss %1,%%xmm0\n\t"
+        "movd %%xmm0,%%edx\n\t"
+        "lock cmpxchg %%edx,%0\n\t"
+        "jnz 1b\n\t"
+        :"+m"(*var)
+         ,"+x"(increment)
+        :
+        :"cc", "xmm0", "eax", "edx");
+  }
 
   /*
   inline static bool CompareAndSwap128(
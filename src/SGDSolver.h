@@ -5,13 +5,18 @@
 
 // Implementation of Solver abstract class for Stochastic Gradient Descent
 // with sparse gradients.
-class SGDSolver : public Solver<Vector, SparseVec> {
-  typedef Solver<Vector, SparseVec> Super;
+// Real is the type of parameters and gradients. With float, parameter
+// vectors take half the memory and bandwidth; the objective and other
+// reductions are still computed in double precision.
+template<class Real>
+class BasicSGDSolver : public Solver<BasicVector<Real>, BasicSparseVec<Real>> {
+  typedef Solver<BasicVector<Real>, BasicSparseVec<Real>> Super;
   
 public:
   typedef typename Super::Solution Solution;
   typedef typename Super::TraceElement TraceElement;
-  typedef Vector ParamVector;
+  typedef BasicVector<Real> ParamVector;
+  typedef BasicSparseVec<Real> Gradient;
   
   struct Options : public Super::Options {
     Options() {}    
@@ -22,6 +27,8 @@ public:
     double step = 1e-4;
     double alpha_step = -1; 
     ParallelMode parallel_mode = ParallelMode::FREE_FOR_ALL;
+    SamplingMode sampling_mode = SamplingMode::UNIFORM;
+    NumaMode numa_mode = NumaMode::NONE;
 
     void print(std::ostream& out) const override {
       const auto &options = *this;
@@ -32,17 +39,34 @@ public:
       out << "Alpha: " << options.alpha_step << std::endl;
       out << "ParallelMode: " <<
           options.parallel_mode.toString() << std::endl;
+      out << "SamplingMode: " <<
+          options.sampling_mode.toString() << std::endl;
+      if(options.numa_mode != NumaMode::NONE) {
+        out << "NumaMode: " << options.numa_mode.toString() << std::endl;
+      }
     }
   };
 
-  SGDSolver(const Options &options = Options())
+  BasicSGDSolver(const Options &options = Options())
       : options_(options) {}
   
   void setOptions(const Options &options) {options_ = options;}  
-  Solution solve(Oracle<Vector, SparseVec> *oracle) override;
+  Solution solve(Oracle<ParamVector, Gradient> *oracle) override {
+    return solveWith(oracle);
+  }
+
+  // Same as solve(), with oracle calls bound at compile time to OracleType,
+  // a class derived from Oracle. With a final oracle class (e.g.
+  // LogisticRegressionOracle), they can be inlined into the update loop.
+  template<class OracleType>
+  Solution solveWith(OracleType *oracle);
 
 private:
   Options options_;
 };
 
+typedef BasicSGDSolver<double> SGDSolver;
+
+#include "SGDSolver_Impl.h"
+
 #endif
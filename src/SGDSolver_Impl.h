@@ -0,0 +1,177 @@
+#include "SGDSolver.h"
+
+#include <atomic>
+#include <cmath>
+#include "PerThread.h"
+#include "VectorUtils.h"
+#include "SpinLock.h"
+
+template<class Real>
+template<class OracleType>
+typename BasicSGDSolver<Real>::Solution BasicSGDSolver<Real>::solveWith(
+    OracleType *oracle) {
+  Solution solution;
+  SpinLock param_lock;
+  std::atomic<unsigned long long> iteration_ctr(1);
+
+  bool use_param_lock = (options_.parallel_mode == ParallelMode::LOCKED);
+  bool use_atomic_add = (options_.parallel_mode == ParallelMode::LOCK_FREE);
+  
+  int n = this->getNumExamples(oracle);
+  int d = oracle->getDimension();
+
+  int num_updates_per_epoch = n * options_.num_nupdates_per_epoch;
+  if(num_updates_per_epoch < 0) {
+    num_updates_per_epoch
+        = static_cast<int>(n / -options_.num_nupdates_per_epoch + 0.5);
+  }
+
+  this->startNumaPlacement(options_.numa_mode);
+
+  double objective = 0.0;
+  BasicVector<Real> x;
+  BasicVector<Real> avg_gradient;
+  this->allocateVector(options_.numa_mode, d, &x);
+  this->allocateVector(options_.numa_mode, d, &avg_gradient);
+
+  int epoch = 0;
+  bool done = false;
+
+  int num_threads = Platform::getNumLocalThreads();
+  std::vector<std::default_random_engine> rand_engines =
+      this->createRandomEngines(num_threads);
+
+  long long timeus = 0;
+  // Order of the window examples in PERMUTATION sampling mode.
+  std::vector<int> permutation;
+  // Gradient buffers of each thread, reused for all updates and epochs.
+  PerThread<Gradient> gradients;
+  // Updates are applied straight from the examples if the oracle supports
+  // it (see Oracle::hasScaledGradients).
+  const bool scaled_gradients = oracle->hasScaledGradients();
+  
+  do {        
+    Platform::Time epoch_start_time = Platform::getCurrentTime();
+    Platform::Time epoch_end_time;
+      
+    // Each window of examples receives a share of the updates that is
+    // proportional to its size.
+    long long num_examples_seen = 0;
+    int num_updates_done = 0;
+
+    this->rewindExamples();
+    while(this->nextWindow()) {
+      const int window_size = oracle->getNumInstances();
+      num_examples_seen += window_size;
+      const int num_window_updates = static_cast<int>(
+          num_examples_seen * num_updates_per_epoch / n) - num_updates_done;
+      num_updates_done += num_window_updates;
+      this->startSampling(options_.sampling_mode, window_size,
+                          rand_engines[0], &permutation);
+
+      #pragma omp parallel 
+      {
+        int thread_id = Platform::getThreadId();
+        std::default_random_engine &r = rand_engines[thread_id];
+        int data_start = 0;
+        int data_end = window_size;
+                  
+        std::uniform_int_distribution<int> u(data_start, data_end-1);
+
+        Gradient &g = gradients.local(); // Gradient at x
+      
+        #pragma omp for schedule(static) 
+        for(int i = 0; i < num_window_updates; ++i) {
+          // Select instance j
+          int j = this->sampleExample(options_.sampling_mode, i,
+                                      window_size, permutation, u, r);
+
+          // Compute gradients        
+          double scale = 0.0;
+          if(scaled_gradients) {scale = oracle->computeGradientScale(x, j);}
+          else {oracle->computeGradient(x, j, g);}
+               
+          // Compute step
+          double step = options_.step;
+          if(options_.alpha_step > 0.0) {
+            double t = static_cast<double>(
+                iteration_ctr.fetch_add(1,std::memory_order_relaxed));
+            step *= sqrt(options_.alpha_step / (t + options_.alpha_step));
+          }        
+        
+          // Apply update        
+          if(use_param_lock) {param_lock.lock();}
+          if(scaled_gradients) {
+            oracle->addScaledGradient(j, x, scale, -step, x, use_atomic_add);
+          } else {
+            VectorUtils::addVector(x, g, -step, use_atomic_add);
+          }
+          if(use_param_lock) {param_lock.unlock();}        
+        }
+      } //end parallel block
+    }
+
+    epoch_end_time = Platform::getCurrentTime();
+    avg_gradient.fill(0.0);            
+    objective = 0.0;
+
+    //Recompute average gradient and objective
+    this->rewindExamples();
+    while(this->nextWindow()) {
+      const int window_size = oracle->getNumInstances();
+
+      #pragma omp parallel
+      {
+        Gradient &g = gradients.local();
+
+        // Chunks of consecutive examples keep the pass over the data
+        // sequential within each thread.
+        #pragma omp for schedule(dynamic, 256) reduction(+:objective) 
+        for(int i = 0; i < window_size; ++i) {
+          double objective_i = oracle->computeObjAndGradient(x, i, g);
+          VectorUtils::addVector(avg_gradient, g, 1.0/n, true);
+          objective += objective_i;
+        }
+      } //end parallel block
+    }
+
+    objective /= n;
+
+    timeus += Platform::getDurationus(epoch_start_time, epoch_end_time);
+    
+    solution.trace.push_back(TraceElement());
+    auto &trace_element = solution.trace.back();
+    trace_element.objective = objective;
+
+    trace_element.timems = timeus / 1000;
+    trace_element.other_info["epoch"] = epoch;
+    double grad_sq_norm = avg_gradient.dot(avg_gradient);
+    trace_element.grad_sq_norm = grad_sq_norm;
+    
+    oracle->evalParams(x, trace_element.other_info);
+
+    ASSERT(!std::isnan(objective), "Objective is NaN");
+    ASSERT(!std::isinf(objective), "Objective is Inf");
+    
+    done = (++epoch >= options_.max_num_epochs
+            && options_.max_num_epochs > 0)
+        || objective <= options_.target_objective;
+
+    double last_step = options_.step;
+    if(options_.alpha_step > 0.0) {
+      double last_t = 1.0 * epoch * num_updates_per_epoch;
+      last_step *= sqrt(options_.alpha_step / (last_t + options_.alpha_step));
+    }
+    
+    LOG(epoch << " " << (timeus / 1000)
+        << ":" << " obj=" << objective
+        << " last_step=" << last_step 
+        << " grad_sq_norm=" << grad_sq_norm);    
+  }while(!done);
+
+  solution.timems = timeus / 1000;
+  solution.x.assign(x.begin(), x.end());
+  solution.objective = objective;
+  
+  return solution;
+}
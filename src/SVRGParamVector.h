@@ -0,0 +1,27 @@
+#ifndef _SVRG_SVRG_PARAM_VECTOR_H_
+#define _SVRG_SVRG_PARAM_VECTOR_H_
+
+#include "Vector.h"
+
+// For effeciency, the SVRG parameter vector is represented as
+// x + avg_gradient_multiple * avg_gradient,
+// where avg_gradient is the average gradient for teh last iterate in the
+// previous epoch and x accumulates sparse updates in the current epoch.
+// Components of x and avg_gradient have type Real (double or float) and are
+// combined in double precision.
+template<class Real>
+struct BasicSVRGParamVector {
+  typedef Real value_type;
+
+  const BasicVector<Real> *x;
+  const BasicVector<Real> *avg_gradient;
+  double avg_gradient_multiple;
+
+  inline double operator[](int index) const {
+    return (*x)[index] + avg_gradient_multiple * (*avg_gradient)[index];
+  }
+};
+
+typedef BasicSVRGParamVector<double> SVRGParamVector;
+
+#endif
@@ -3,40 +3,43 @@
 
 #include "Solver.h"
 #include "SGDSolver.h"
-
-// For effeciency, the SVRG parameter vector is represented as
-// x + avg_gradient_multiple * avg_gradient,
-// where avg_gradient is the average gradient for teh last iterate in the
-// previous epoch and x accumulates sparse updates in the current epoch.
-struct SVRGParamVector {
-  const Vector *x;
-  const Vector *avg_gradient;
-  double avg_gradient_multiple;
-
-  inline double operator[](int index) const {
-    return (*x)[index] + avg_gradient_multiple * (*avg_gradient)[index];
-  }
-};
+#include "SVRGParamVector.h"
 
 // Implementation of Solver abstract class for SVRG with sparse gradients.
-class SVRGSolver : public Solver<SVRGParamVector, SparseVec> {
-  typedef Solver<SVRGParamVector, SparseVec> Super;
+// Real is the type of parameters and gradients (see BasicSGDSolver).
+template<class Real>
+class BasicSVRGSolver
+    : public Solver<BasicSVRGParamVector<Real>, BasicSparseVec<Real>> {
+  typedef Solver<BasicSVRGParamVector<Real>, BasicSparseVec<Real>> Super;
   
 public:
   typedef typename Super::Solution Solution;
   typedef typename Super::TraceElement TraceElement;
-  typedef SVRGParamVector ParamVector;
+  typedef BasicSVRGParamVector<Real> ParamVector;
+  typedef BasicSparseVec<Real> Gradient;
   
-  typedef SGDSolver::Options Options;
+  typedef typename BasicSGDSolver<Real>::Options Options;
 
-  SVRGSolver(const Options &options = Options())
+  BasicSVRGSolver(const Options &options = Options())
       : options_(options) {}
   
   void setOptions(const Options &options) {options_ = options;}  
-  Solution solve(Oracle<SVRGParamVector, SparseVec> *oracle) override;
+  Solution solve(Oracle<ParamVector, Gradient> *oracle) override {
+    return solveWith(oracle);
+  }
+
+  // Same as solve(), with oracle calls bound at compile time to OracleType,
+  // a class derived from Oracle. With a final oracle class (e.g.
+  // LogisticRegressionOracle), they can be inlined into the update loop.
+  template<class OracleType>
+  Solution solveWith(OracleType *oracle);
 
 private:
   Options options_;
 };
 
+typedef BasicSVRGSolver<double> SVRGSolver;
+
+#include "SVRGSolver_Impl.h"
+
 #endif
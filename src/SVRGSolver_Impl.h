@@ -0,0 +1,270 @@
+#include "SVRGSolver.h"
+
+#include <atomic>
+#include <cmath>
+#include "PerThread.h"
+#include "VectorUtils.h"
+#include "SpinLock.h"
+
+template<class Real>
+template<class OracleType>
+typename BasicSVRGSolver<Real>::Solution BasicSVRGSolver<Real>::solveWith(
+    OracleType *oracle) {
+  Solution solution;
+  SpinLock param_lock;
+  std::atomic<unsigned long long> iteration_ctr(1);
+
+  bool use_param_lock = (options_.parallel_mode == ParallelMode::LOCKED);
+  bool use_atomic_add = (options_.parallel_mode == ParallelMode::LOCK_FREE);
+  
+  int n = this->getNumExamples(oracle);
+  int d = oracle->getDimension();
+  double avg_gradient_multiple = 0.0;
+
+  int num_updates_per_epoch = n * options_.num_nupdates_per_epoch;
+  if(num_updates_per_epoch < 0) {
+    num_updates_per_epoch
+        = static_cast<int>(n / -options_.num_nupdates_per_epoch + 0.5);
+  }
+
+  const NumaMode numa_mode = options_.numa_mode;
+  this->startNumaPlacement(numa_mode);
+
+  double objective = 0.0;
+  BasicVector<Real> x;
+  BasicVector<Real> x_last_epoch;
+  BasicVector<Real> avg_gradient;
+  this->allocateVector(numa_mode, d, &x);
+  this->allocateVector(numa_mode, d, &x_last_epoch);
+  this->allocateVector(numa_mode, d, &avg_gradient);
+
+  int epoch = 0;
+  bool done = false;
+
+  int num_threads = Platform::getNumLocalThreads();
+
+  // In REPLICATE mode, updates read the copies of x_last_epoch and
+  // avg_gradient on the node of their thread.
+  const bool replicate = (numa_mode == NumaMode::REPLICATE);
+  const int num_replicas = replicate ?Numa::numNodes() :0;
+  std::vector<BasicVector<Real>> x_last_epoch_replicas(num_replicas);
+  std::vector<BasicVector<Real>> avg_gradient_replicas(num_replicas);
+  for(int node = 0; node < num_replicas; ++node) {
+    this->allocateVector(numa_mode, d, &x_last_epoch_replicas[node], node);
+    this->allocateVector(numa_mode, d, &avg_gradient_replicas[node], node);
+  }
+  auto rand_engines = this->createRandomEngines(num_threads);
+
+  long long timeus = 0;
+  // Order of the window examples in PERMUTATION sampling mode.
+  std::vector<int> permutation;
+  // Gradient buffers of each thread, reused for all updates and epochs.
+  PerThread<Gradient> gradients;
+  PerThread<Gradient> last_epoch_gradients;
+  // Updates are applied straight from the examples if the oracle supports
+  // it (see Oracle::hasScaledGradients).
+  const bool scaled_gradients = oracle->hasScaledGradients();
+
+  g_monitor_new = true;
+  
+  do {        
+    avg_gradient_multiple = 0.0;
+
+    Platform::Time epoch_start_time = Platform::getCurrentTime();
+    Platform::Time epoch_end_time;
+      
+    // Each window of examples receives a share of the updates that is
+    // proportional to its size.
+    long long num_examples_seen = 0;
+    int num_updates_done = 0;
+
+    this->rewindExamples();
+    while(this->nextWindow()) {
+      const int window_size = oracle->getNumInstances();
+      num_examples_seen += window_size;
+      const int num_window_updates = static_cast<int>(
+          num_examples_seen * num_updates_per_epoch / n) - num_updates_done;
+      num_updates_done += num_window_updates;
+      this->startSampling(options_.sampling_mode, window_size,
+                          rand_engines[0], &permutation);
+
+      #pragma omp parallel 
+      {
+        int thread_id = Platform::getThreadId();
+        std::default_random_engine &r = rand_engines[thread_id];
+        int data_start = 0;
+        int data_end = window_size;
+                  
+        std::uniform_int_distribution<int> u(data_start, data_end-1);
+        const int node = Numa::nodeOfThread(thread_id, num_threads);
+        const BasicVector<Real> *last_epoch_x =
+            replicate ?&x_last_epoch_replicas[node] :&x_last_epoch;
+        ParamVector param_spec;
+        param_spec.avg_gradient =
+            replicate ?&avg_gradient_replicas[node] :&avg_gradient;
+        ParamVector last_param_spec;
+        last_param_spec.x = last_epoch_x;
+        last_param_spec.avg_gradient = param_spec.avg_gradient;
+        last_param_spec.avg_gradient_multiple = 0.0;
+
+        Gradient &g = gradients.local(); // Gradient at x
+        // Gradient at x_last_epoch
+        Gradient &g2 = last_epoch_gradients.local();
+      
+        #pragma omp for schedule(static) 
+        for(int i = 0; i < num_window_updates; ++i) {
+          // Select instance j
+          int j = this->sampleExample(options_.sampling_mode, i,
+                                      window_size, permutation, u, r);
+       
+          // Compute gradients        
+          param_spec.x = &x;
+          param_spec.avg_gradient_multiple = avg_gradient_multiple;
+          double scale = 0.0;
+          double last_scale = 0.0;
+
+          if(scaled_gradients) {
+            // Fused path: one pass over the instance for both margins, then
+            // one pass for the variance-reduced update below.
+            if(epoch > 0) {
+              oracle->computeGradientScales(param_spec, last_param_spec, j,
+                                            &scale, &last_scale);
+            } else {
+              scale = oracle->computeGradientScale(param_spec, j);
+            }
+          } else {
+            oracle->computeGradient(param_spec, j, g);
+
+            if(epoch > 0) {
+              // Compute gradient difference w.r.t last epoch
+              oracle->computeGradient(last_param_spec, j, g2);
+              VectorUtils::addCompatibleVec(g, 1.0, g2, -1.0);
+            }
+          }
+        
+          // Compute step
+          double step = options_.step;
+          if(options_.alpha_step > 0.0) {
+            double t = static_cast<double>(
+                iteration_ctr.fetch_add(1,std::memory_order_relaxed));
+            step *= sqrt(options_.alpha_step / (t + options_.alpha_step));
+          }        
+
+          // Apply update        
+          if(use_param_lock) {param_lock.lock();}
+          if(!scaled_gradients) {
+            VectorUtils::addVector(x, g, -step, use_atomic_add);
+          } else if(epoch > 0) {
+            oracle->addScaledGradientDifference(j, param_spec, scale,
+                                                last_param_spec, last_scale,
+                                                -step, x, use_atomic_add);
+          } else {
+            oracle->addScaledGradient(j, param_spec, scale, -step, x,
+                                      use_atomic_add);
+          }
+
+          if(epoch > 0) {
+            // Subract average gradient
+            if(use_atomic_add) {
+              Platform::atomicAdd(&avg_gradient_multiple, -step);
+            } else {
+              avg_gradient_multiple -= step;
+            }
+          }
+        
+          if(use_param_lock) {param_lock.unlock();}        
+        }
+      } //end parallel block
+    }
+
+    VectorUtils::addVector(x, 1.0, avg_gradient, avg_gradient_multiple);
+
+    x_last_epoch = x;
+    avg_gradient.fill(0.0);            
+    objective = 0.0;
+
+    //Recompute average gradient and objective. With a stream, this is a
+    //second pass over the file.
+    ParamVector param_spec;
+    param_spec.x = &x;
+    param_spec.avg_gradient = &avg_gradient;
+    param_spec.avg_gradient_multiple = 0.0;
+
+    this->rewindExamples();
+    while(this->nextWindow()) {
+      const int window_size = oracle->getNumInstances();
+
+      #pragma omp parallel
+      {
+        Gradient &g = gradients.local();
+
+        // Chunks of consecutive examples keep the pass over the data
+        // sequential within each thread.
+        #pragma omp for schedule(dynamic, 256) reduction(+:objective) 
+        for(int i = 0; i < window_size; ++i) {
+          double objective_i = oracle->computeObjAndGradient(param_spec, i, g);
+          VectorUtils::addVector(avg_gradient, g, 1.0/n, true);
+          objective += objective_i;
+        }
+      } //end parallel block
+    }
+
+    objective /= n;
+
+    if(replicate) {
+      #pragma omp parallel for schedule(static)
+      for(int i = 0; i < d; ++i) {
+        for(int node = 0; node < num_replicas; ++node) {
+          x_last_epoch_replicas[node][i] = x_last_epoch[i];
+          avg_gradient_replicas[node][i] = avg_gradient[i];
+        }
+      }
+    }
+
+    // In SVRG, computing the true gradient is part of the algorithm and
+    // its time should be measured
+    epoch_end_time = Platform::getCurrentTime();
+
+    timeus += Platform::getDurationus(epoch_start_time, epoch_end_time);
+    
+    solution.trace.push_back(TraceElement());
+    auto &trace_element = solution.trace.back();
+    trace_element.objective = objective;
+
+    trace_element.timems = timeus / 1000;
+    trace_element.other_info["epoch"] = epoch;
+    double grad_sq_norm = avg_gradient.dot(avg_gradient);
+    trace_element.grad_sq_norm = grad_sq_norm;
+
+    ParamVector eval_x;
+    eval_x.x = &x;
+    eval_x.avg_gradient = &avg_gradient;
+    eval_x.avg_gradient_multiple = 0.0;
+    
+    oracle->evalParams(eval_x, trace_element.other_info);
+
+    ASSERT(!std::isnan(objective), "Objective is NaN");
+    ASSERT(!std::isinf(objective), "Objective is Inf");
+    
+    done = (++epoch >= options_.max_num_epochs
+            && options_.max_num_epochs > 0)
+        || objective <= options_.target_objective;
+
+    double last_step = options_.step;
+    if(options_.alpha_step > 0.0) {
+      double last_t = 1.0 * epoch * num_updates_per_epoch;
+      last_step *= sqrt(options_.alpha_step / (last_t + options_.alpha_step));
+    }
+    
+    LOG(epoch << " " << (timeus / 1000)
+        << ":" << " obj=" << objective
+        << " last_step=" << last_step 
+        << " grad_sq_norm=" << grad_sq_norm);    
+  }while(!done);
+
+  solution.timems = timeus / 1000;
+  solution.x.assign(x.begin(), x.end());
+  solution.objective = objective;
+  
+  return solution;
+}
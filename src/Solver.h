@@ -1,12 +1,16 @@
 #ifndef _SVRG_SOLVER_H_
 #define _SVRG_SOLVER_H_
 
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <limits>
 #include <memory>
 #include <vector>
 #include "Platform.h"
+#include "ExampleStream.h"
+#include "Numa.h"
 #include "Oracle.h"
 
 // A class representing possible parallel modes. Can be used as a scoped enum
@@ -44,6 +48,84 @@ class ParallelMode {
   Mode mode_;
 };
 
+// Specifies how stochastic updates select examples. Can be used as a scoped
+// enum but supports toString and fromString methods.
+class SamplingMode {
+ public:
+  enum Mode {
+    UNIFORM, // Uniformly at random with replacement.
+    PERMUTATION, // Without replacement, following a new random permutation
+                 // of the examples in every epoch.
+    SEQUENTIAL // In stored order, e.g. for files shuffled in advance
+               // (see bin/opt/reorder --method=random).
+  };
+
+  SamplingMode(Mode mode)
+      : mode_(mode) {}
+
+  operator Mode() const {return mode_;}
+
+  std::string toString() const {
+    switch(mode_) {
+      case SamplingMode::UNIFORM: return "UNIFORM"; break;
+      case SamplingMode::PERMUTATION: return "PERMUTATION"; break;
+      case SamplingMode::SEQUENTIAL: return "SEQUENTIAL"; break;
+      default: return ""; break;
+    }
+  }
+
+  static SamplingMode fromString(const std::string &str) {
+    if(str == "UNIFORM") {return SamplingMode::UNIFORM;}
+    else if(str == "PERMUTATION") {return SamplingMode::PERMUTATION;}
+    else if(str == "SEQUENTIAL") {return SamplingMode::SEQUENTIAL;}
+    else {ASSERT(false, "Invalid sampling mode.");}
+    return SamplingMode::UNIFORM;
+  }
+
+ private:
+  Mode mode_;
+};
+
+// Specifies how solvers place threads and parameter vectors on NUMA nodes
+// (see Numa.h). Can be used as a scoped enum but supports toString and
+// fromString methods.
+class NumaMode {
+ public:
+  enum Mode {
+    NONE, // No pinning; pages are placed where the master thread runs.
+    INTERLEAVE, // Threads are pinned to nodes and the pages of parameter
+                // vectors are interleaved over all nodes.
+    REPLICATE // As INTERLEAVE, but vectors that updates only read (SVRG's
+              // x_last_epoch and avg_gradient) are copied to every node
+              // after each full gradient.
+  };
+
+  NumaMode(Mode mode)
+      : mode_(mode) {}
+
+  operator Mode() const {return mode_;}
+
+  std::string toString() const {
+    switch(mode_) {
+      case NumaMode::NONE: return "NONE"; break;
+      case NumaMode::INTERLEAVE: return "INTERLEAVE"; break;
+      case NumaMode::REPLICATE: return "REPLICATE"; break;
+      default: return ""; break;
+    }
+  }
+
+  static NumaMode fromString(const std::string &str) {
+    if(str == "NONE") {return NumaMode::NONE;}
+    else if(str == "INTERLEAVE") {return NumaMode::INTERLEAVE;}
+    else if(str == "REPLICATE") {return NumaMode::REPLICATE;}
+    else {ASSERT(false, "Invalid NUMA mode.");}
+    return NumaMode::NONE;
+  }
+
+ private:
+  Mode mode_;
+};
+
 // Template abstract class for solvers.
 // Template parameters specify paramater vector representation and gradient
 // representation.
@@ -68,9 +150,82 @@ class Solver {
     std::vector<TraceElement> trace;
   };
 
+  virtual ~Solver() {}
+
   virtual Solution solve(Oracle<ParamVector, Gradient> *oracle) = 0;
 
+  // Makes the solver read examples window by window from stream. The oracle
+  // must compute gradients for the examples of the current window.
+  // If no stream is set, the oracle holds all examples.
+  void setExampleStream(ExampleStream *stream) {stream_ = stream;}
+
  protected:
+  // Total number of examples.
+  int getNumExamples(const Oracle<ParamVector, Gradient> *oracle) const {
+    return stream_ == 0 ?oracle->getNumInstances() :stream_->numExamples();
+  }
+
+  // Starts a pass over the examples. Each call to nextWindow() then makes
+  // the next window of examples available through the oracle; without a
+  // stream there is a single window with all examples.
+  void rewindExamples() {
+    if(stream_ != 0) {stream_->rewind();}
+    window_loaded_ = false;
+  }
+
+  bool nextWindow() {
+    if(stream_ != 0) {return stream_->nextWindow();}
+    bool first_window = !window_loaded_;
+    window_loaded_ = true;
+    return first_window;
+  }
+
+  // Prepares the selection of examples for the updates of a window of
+  // window_size examples: in PERMUTATION mode, shuffles the window into
+  // 'permutation'.
+  static void startSampling(SamplingMode mode, int window_size,
+                            std::default_random_engine &r,
+                            std::vector<int> *permutation) {
+    if(mode != SamplingMode::PERMUTATION) {return;}
+    permutation->resize(window_size);
+    std::iota(permutation->begin(), permutation->end(), 0);
+    std::shuffle(permutation->begin(), permutation->end(), r);
+  }
+
+  // Returns the example for update 'update' of a window. Updates beyond the
+  // window size wrap around. With a static schedule, every thread then
+  // visits a contiguous range of examples in SEQUENTIAL mode.
+  static int sampleExample(SamplingMode mode, int update, int window_size,
+                           const std::vector<int> &permutation,
+                           std::uniform_int_distribution<int> &u,
+                           std::default_random_engine &r) {
+    switch(mode) {
+      case SamplingMode::PERMUTATION: return permutation[update % window_size];
+      case SamplingMode::SEQUENTIAL: return update % window_size;
+      default: return u(r);
+    }
+  }
+
+  // Pins threads to NUMA nodes unless mode is NONE.
+  static void startNumaPlacement(NumaMode mode) {
+    if(mode == NumaMode::NONE) {return;}
+    if(!Numa::pinThreads()) {LOG("Could not pin threads to NUMA nodes");}
+    LOG("Threads are on " << Numa::numNodes() << " NUMA nodes");
+  }
+
+  // Sets 'vector' to a zero vector of dimension d. Unless mode is NONE,
+  // its pages are interleaved over the NUMA nodes, or placed on 'node' if
+  // it is not negative.
+  template<class Vector>
+  static void allocateVector(NumaMode mode, int d, Vector *vector,
+                             int node = -1) {
+    if(mode == NumaMode::NONE) {
+      vector->assign(d, 0.0);
+    } else {
+      Numa::allocate(vector, d, node);
+    }
+  }
+
   // Creates a vector of random engines initialized with different prime
   // seeds.
   static std::vector<std::default_random_engine> createRandomEngines(
@@ -91,6 +246,10 @@ class Solver {
 
     return rand_engines;
   }
+
+ private:
+  ExampleStream *stream_ = 0;
+  bool window_loaded_ = false;
 };
 
 #endif
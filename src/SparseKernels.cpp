@@ -0,0 +1,300 @@
+#include "SparseKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SVRG_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar
+
+template<int N, class Value, class Real>
+static void dotScalar(const int32_t *indices, const Value *values,
+                      size_t size, double value_scale,
+                      const Real *const *dense, double *output) {
+  double sums[N] = {};
+
+  for(size_t k = 0; k < size; ++k) {
+    const double value = value_scale * values[k];
+    for(int j = 0; j < N; ++j) {sums[j] += value * dense[j][indices[k]];}
+  }
+
+  for(int j = 0; j < N; ++j) {output[j] = sums[j];}
+}
+
+template<class Value, class Real>
+static void axpyScalar(const int32_t *indices, const Value *values,
+                       size_t size, double value_scale, double scale,
+                       Real *dense) {
+  for(size_t k = 0; k < size; ++k) {
+    dense[indices[k]] += value_scale * values[k] * scale;
+  }
+}
+
+#ifdef SVRG_X86_KERNELS
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2: 4 doubles per vector.
+
+#define SVRG_AVX2 __attribute__((target("avx2,fma")))
+
+SVRG_AVX2 static inline __m256d load4(const double *values) {
+  return _mm256_loadu_pd(values);
+}
+
+SVRG_AVX2 static inline __m256d load4(const float *values) {
+  return _mm256_cvtps_pd(_mm_loadu_ps(values));
+}
+
+// Gathers use the masked forms, whose unmasked counterparts have undefined
+// source operands that GCC warns about.
+SVRG_AVX2 static inline __m256d gather4(const double *dense, __m128i index) {
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), dense, index, all, 8);
+}
+
+SVRG_AVX2 static inline __m256d gather4(const float *dense, __m128i index) {
+  const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  return _mm256_cvtps_pd(
+      _mm_mask_i32gather_ps(_mm_setzero_ps(), dense, index, all, 4));
+}
+
+SVRG_AVX2 static inline void store4(double *output, __m256d values) {
+  _mm256_storeu_pd(output, values);
+}
+
+SVRG_AVX2 static inline void store4(float *output, __m256d values) {
+  _mm_storeu_ps(output, _mm256_cvtpd_ps(values));
+}
+
+SVRG_AVX2 static inline double sum4(__m256d values) {
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(values),
+                           _mm256_extractf128_pd(values, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+template<int N, class Value, class Real>
+SVRG_AVX2 static void dotAvx2(const int32_t *indices, const Value *values,
+                              size_t size, double value_scale,
+                              const Real *const *dense, double *output) {
+  const __m256d scale = _mm256_set1_pd(value_scale);
+  __m256d sums[N];
+  for(int j = 0; j < N; ++j) {sums[j] = _mm256_setzero_pd();}
+
+  size_t k = 0;
+  for(; k + 4 <= size; k += 4) {
+    const __m128i index = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(indices + k));
+    const __m256d value = _mm256_mul_pd(scale, load4(values + k));
+    for(int j = 0; j < N; ++j) {
+      sums[j] = _mm256_fmadd_pd(value, gather4(dense[j], index), sums[j]);
+    }
+  }
+
+  for(int j = 0; j < N; ++j) {output[j] = sum4(sums[j]);}
+
+  for(; k < size; ++k) {
+    const double value = value_scale * values[k];
+    for(int j = 0; j < N; ++j) {output[j] += value * dense[j][indices[k]];}
+  }
+}
+
+// AVX2 has no scatter: updates are computed 4 at a time and stored one by
+// one. Multiplications and additions are not fused, so that results are
+// the same as with axpyScalar.
+template<class Value, class Real>
+SVRG_AVX2 static void axpyAvx2(const int32_t *indices, const Value *values,
+                               size_t size, double value_scale, double scale,
+                               Real *dense) {
+  const __m256d value_scale4 = _mm256_set1_pd(value_scale);
+  const __m256d scale4 = _mm256_set1_pd(scale);
+  Real updated[4];
+
+  size_t k = 0;
+  for(; k + 4 <= size; k += 4) {
+    const __m128i index = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(indices + k));
+    const __m256d increment = _mm256_mul_pd(
+        _mm256_mul_pd(value_scale4, load4(values + k)), scale4);
+    store4(updated, _mm256_add_pd(gather4(dense, index), increment));
+
+    dense[indices[k]] = updated[0];
+    dense[indices[k + 1]] = updated[1];
+    dense[indices[k + 2]] = updated[2];
+    dense[indices[k + 3]] = updated[3];
+  }
+
+  axpyScalar(indices + k, values + k, size - k, value_scale, scale, dense);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AVX-512: 8 doubles per vector. Tails use masks. As with AVX2,
+// conversions and extractions use the masked forms.
+
+#define SVRG_AVX512 __attribute__((target("avx512f,avx512vl")))
+
+SVRG_AVX512 static inline __m256i loadIndices8(const int32_t *indices,
+                                               __mmask8 mask) {
+  return _mm256_maskz_loadu_epi32(mask, indices);
+}
+
+SVRG_AVX512 static inline __m512d load8(const double *values,
+                                        __mmask8 mask) {
+  return _mm512_maskz_loadu_pd(mask, values);
+}
+
+SVRG_AVX512 static inline __m512d load8(const float *values, __mmask8 mask) {
+  return _mm512_maskz_cvtps_pd(0xFF, _mm256_maskz_loadu_ps(mask, values));
+}
+
+SVRG_AVX512 static inline __m512d gather8(const double *dense, __m256i index,
+                                          __mmask8 mask) {
+  return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, index, dense, 8);
+}
+
+SVRG_AVX512 static inline __m512d gather8(const float *dense, __m256i index,
+                                          __mmask8 mask) {
+  return _mm512_maskz_cvtps_pd(0xFF, _mm256_mmask_i32gather_ps(
+      _mm256_setzero_ps(), mask, index, dense, 4));
+}
+
+SVRG_AVX512 static inline void scatter8(double *dense, __m256i index,
+                                        __m512d values, __mmask8 mask) {
+  _mm512_mask_i32scatter_pd(dense, mask, index, values, 8);
+}
+
+SVRG_AVX512 static inline void scatter8(float *dense, __m256i index,
+                                        __m512d values, __mmask8 mask) {
+  _mm256_mask_i32scatter_ps(dense, mask, index,
+                            _mm512_maskz_cvtpd_ps(0xFF, values), 4);
+}
+
+SVRG_AVX512 static inline double sum8(__m512d values) {
+  return sum4(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, values, 0),
+                            _mm512_maskz_extractf64x4_pd(0xF, values, 1)));
+}
+
+template<int N, class Value, class Real>
+SVRG_AVX512 static void dotAvx512(const int32_t *indices, const Value *values,
+                                  size_t size, double value_scale,
+                                  const Real *const *dense, double *output) {
+  const __m512d scale = _mm512_set1_pd(value_scale);
+  __m512d sums[N];
+  for(int j = 0; j < N; ++j) {sums[j] = _mm512_setzero_pd();}
+
+  for(size_t k = 0; k < size; k += 8) {
+    const __mmask8 mask = (size - k >= 8) ?0xFF :(1u << (size - k)) - 1;
+    const __m256i index = loadIndices8(indices + k, mask);
+    const __m512d value = _mm512_mul_pd(scale, load8(values + k, mask));
+    for(int j = 0; j < N; ++j) {
+      sums[j] = _mm512_fmadd_pd(value, gather8(dense[j], index, mask),
+                                sums[j]);
+    }
+  }
+
+  for(int j = 0; j < N; ++j) {output[j] = sum8(sums[j]);}
+}
+
+// As axpyAvx2, but stored with scatters.
+template<class Value, class Real>
+SVRG_AVX512 static void axpyAvx512(const int32_t *indices,
+                                   const Value *values, size_t size,
+                                   double value_scale, double scale,
+                                   Real *dense) {
+  const __m512d value_scale8 = _mm512_set1_pd(value_scale);
+  const __m512d scale8 = _mm512_set1_pd(scale);
+
+  for(size_t k = 0; k < size; k += 8) {
+    const __mmask8 mask = (size - k >= 8) ?0xFF :(1u << (size - k)) - 1;
+    const __m256i index = loadIndices8(indices + k, mask);
+    const __m512d increment = _mm512_mul_pd(
+        _mm512_mul_pd(value_scale8, load8(values + k, mask)), scale8);
+    scatter8(dense, index,
+             _mm512_add_pd(gather8(dense, index, mask), increment), mask);
+  }
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Dispatch
+
+SimdIsa SparseKernels::bestIsa() {
+#ifdef SVRG_X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+    return SimdIsa::AVX512;
+  }
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SimdIsa::AVX2;
+  }
+#endif
+  return SimdIsa::SCALAR;
+}
+
+static SimdIsa::Mode g_isa = SparseKernels::bestIsa();
+
+SimdIsa SparseKernels::isa() {
+  return g_isa;
+}
+
+void SparseKernels::setIsa(SimdIsa isa) {
+  ASSERT(isa <= bestIsa(), isa.toString() << " is not supported by the CPU");
+  g_isa = isa;
+}
+
+template<int N, class Value, class Real>
+void SparseKernels::dot(const int32_t *indices, const Value *values,
+                        size_t size, double value_scale,
+                        const Real *const *dense, double *output) {
+  switch(size < MIN_SIMD_SIZE ?SimdIsa::SCALAR :g_isa) {
+#ifdef SVRG_X86_KERNELS
+    case SimdIsa::AVX512:
+      dotAvx512<N>(indices, values, size, value_scale, dense, output);
+      break;
+    case SimdIsa::AVX2:
+      dotAvx2<N>(indices, values, size, value_scale, dense, output);
+      break;
+#endif
+    default:
+      dotScalar<N>(indices, values, size, value_scale, dense, output);
+      break;
+  }
+}
+
+template<class Value, class Real>
+void SparseKernels::axpy(const int32_t *indices, const Value *values,
+                         size_t size, double value_scale, double scale,
+                         Real *dense) {
+  switch(size < MIN_SIMD_SIZE ?SimdIsa::SCALAR :g_isa) {
+#ifdef SVRG_X86_KERNELS
+    case SimdIsa::AVX512:
+      axpyAvx512(indices, values, size, value_scale, scale, dense);
+      break;
+    case SimdIsa::AVX2:
+      axpyAvx2(indices, values, size, value_scale, scale, dense);
+      break;
+#endif
+    default:
+      axpyScalar(indices, values, size, value_scale, scale, dense);
+      break;
+  }
+}
+
+#define SVRG_INSTANTIATE_KERNELS(Value, Real) \
+  template void SparseKernels::dot<1, Value, Real>( \
+      const int32_t *, const Value *, size_t, double, const Real *const *, \
+      double *); \
+  template void SparseKernels::dot<2, Value, Real>( \
+      const int32_t *, const Value *, size_t, double, const Real *const *, \
+      double *); \
+  template void SparseKernels::dot<3, Value, Real>( \
+      const int32_t *, const Value *, size_t, double, const Real *const *, \
+      double *); \
+  template void SparseKernels::axpy<Value, Real>( \
+      const int32_t *, const Value *, size_t, double, double, Real *);
+
+SVRG_INSTANTIATE_KERNELS(float, float)
+SVRG_INSTANTIATE_KERNELS(float, double)
+SVRG_INSTANTIATE_KERNELS(double, float)
+SVRG_INSTANTIATE_KERNELS(double, double)
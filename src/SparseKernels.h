@@ -0,0 +1,84 @@
+#ifndef _SVRG_SPARSE_KERNELS_H_
+#define _SVRG_SPARSE_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Instruction sets of SparseKernels.
+class SimdIsa {
+ public:
+  enum Mode {
+    SCALAR,
+    AVX2, // AVX2 gathers and FMA; updates are stored one by one.
+    AVX512 // AVX-512F/VL gathers and scatters, with masked tails.
+  };
+
+  SimdIsa(Mode mode)
+      : mode_(mode) {}
+
+  operator Mode() const {return mode_;}
+
+  std::string toString() const {
+    switch(mode_) {
+      case SimdIsa::SCALAR: return "SCALAR"; break;
+      case SimdIsa::AVX2: return "AVX2"; break;
+      case SimdIsa::AVX512: return "AVX512"; break;
+      default: return ""; break;
+    }
+  }
+
+  static SimdIsa fromString(const std::string &str) {
+    if(str == "SCALAR") {return SimdIsa::SCALAR;}
+    else if(str == "AVX2") {return SimdIsa::AVX2;}
+    else if(str == "AVX512") {return SimdIsa::AVX512;}
+    else {ASSERT(false, "Invalid instruction set.");}
+    return SimdIsa::SCALAR;
+  }
+
+ private:
+  Mode mode_;
+};
+
+// Kernels between a sparse vector, given as arrays of 32 bit indices and of
+// values (float or double) that are multiplied by value_scale, and dense
+// arrays of Real (float or double). Products and sums are computed in
+// double precision.
+//
+// Each kernel has a scalar, an AVX2 and an AVX-512 version. The SIMD
+// versions are compiled with target attributes, so that the build does not
+// need -march, and the best version the CPU supports is selected at startup
+// (__builtin_cpu_supports). Dot products summed in SIMD lanes can differ
+// from the scalar ones in the last bits; updates are the same.
+//
+// Gathers and scatters only pay off on long sparse vectors: accesses to
+// large dense arrays are bound by memory latency, and on short vectors the
+// setup and the lane sums cost more than they save. Shorter vectors than
+// MIN_SIMD_SIZE always use the scalar kernels.
+class SparseKernels {
+ public:
+  static constexpr size_t MIN_SIMD_SIZE = 128;
+
+  static SimdIsa isa();
+
+  // Selects the kernels to use. The CPU must support them (see bestIsa).
+  static void setIsa(SimdIsa isa);
+
+  // The widest instruction set supported by the CPU.
+  static SimdIsa bestIsa();
+
+  // Computes output[j] = sum_k value_scale * values[k] * dense[j][indices[k]]
+  // for the N dense arrays (1 to 3) in a single pass over the sparse vector.
+  template<int N, class Value, class Real>
+  static void dot(const int32_t *indices, const Value *values, size_t size,
+                  double value_scale, const Real *const *dense,
+                  double *output);
+
+  // Computes dense[indices[k]] += value_scale * values[k] * scale.
+  // Indices must be distinct.
+  template<class Value, class Real>
+  static void axpy(const int32_t *indices, const Value *values, size_t size,
+                   double value_scale, double scale, Real *dense);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "StreamingDataset.h"
+
+bool StreamingDataset::open() {
+  if(!reader_.init()) {return false;}
+
+  num_examples_ = reader_.num_examples();
+  num_features_ = reader_.num_features();
+
+  if(stats_ != 0) {
+    ASSERT(stats_->num_examples() == num_examples_
+           && stats_->num_features() == num_features_,
+           "Statistics do not match the training file");
+    feature_counts_ = stats_->feature_counts();
+  } else {
+    feature_counts_.assign(num_features_, 0);
+
+    while(reader_.read(&example_)) {
+      for(VectorIterator<SparseVec> it(example_.feats); it; it.next()) {
+        ++feature_counts_[it.index()];
+      }
+    }
+  }
+
+  window_.clear();
+  window_start_ = 0;
+  window_.set_num_features(num_features_);
+  return true;
+}
+
+void StreamingDataset::rewind() {
+  bool init_succeed = reader_.init();
+  ASSERT(init_succeed, "Could not reopen training file");
+  window_.clear();
+  window_start_ = 0;
+}
+
+bool StreamingDataset::nextWindow() {
+  window_start_ += window_.size();
+  window_.clear();
+
+  // Bytes used by an example (row offset, label and scale) and by a
+  // non-zero feature (index and value).
+  const size_t example_bytes = sizeof(size_t) + 2 * sizeof(double);
+  const size_t nonzero_bytes = sizeof(int) + sizeof(float);
+
+  while(window_.size() * example_bytes
+        + window_.num_nonzero() * nonzero_bytes < window_bytes_
+        && reader_.read(&example_)) {
+    window_.addExample(example_.feats, example_.label > 0.0 ?1.0 :0.0);
+  }
+
+  if(normalize_examples_ && stats_ != 0) {
+    window_.normalize(stats_->norms(), window_start_);
+  } else if(normalize_examples_) {
+    window_.normalize();
+  }
+  return window_.size() > 0;
+}
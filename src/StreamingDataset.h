@@ -0,0 +1,60 @@
+#ifndef _SVRG_STREAMINGDATASET_H_
+#define _SVRG_STREAMINGDATASET_H_
+
+#include <string>
+#include <vector>
+
+#include "CSRDataset.h"
+#include "DataReader.h"
+#include "DatasetStats.h"
+#include "ExampleStream.h"
+
+// A training set that is read from a binary file (version 1 or 2) in windows
+// of consecutive examples, so that only one window is kept in memory.
+// The window is stored in a CSRDataset whose arrays are reused, so memory is
+// bounded by the window size plus one example. Labels are converted to 0/1.
+// If statistics of the file are given (see DatasetStats), they provide the
+// feature counts and example norms.
+class StreamingDataset : public ExampleStream {
+ public:
+  StreamingDataset(const std::string &file_name, bool normalize_examples,
+                   size_t window_bytes = DEFAULT_WINDOW_BYTES,
+                   const DatasetStats *stats = 0)
+      : reader_(file_name), normalize_examples_(normalize_examples),
+        window_bytes_(window_bytes), stats_(stats) {}
+
+  // Reads the file once to count examples and per-feature non-zeros, unless
+  // statistics are given. Returns false if the file cannot be read.
+  bool open();
+
+  int64_t numExamples() const override {return num_examples_;}
+  void rewind() override;
+  bool nextWindow() override;
+
+  // Examples of the current window.
+  const CSRDataset &window() const {return window_;}
+
+  int num_features() const {return num_features_;}
+
+  // Number of examples where each feature is not zero, over the whole file.
+  const std::vector<int> &feature_counts() const {return feature_counts_;}
+
+  static constexpr size_t DEFAULT_WINDOW_BYTES = 256 * 1024 * 1024;
+
+ private:
+  BinaryDataReader reader_;
+  bool normalize_examples_;
+  size_t window_bytes_;
+  const DatasetStats *stats_;
+
+  int64_t num_examples_ = 0;
+  int num_features_ = 0;
+  std::vector<int> feature_counts_;
+
+  CSRDataset window_;
+  // Index of the first example of the window.
+  int64_t window_start_ = 0;
+  SparseExample example_;
+};
+
+#endif
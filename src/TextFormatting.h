@@ -0,0 +1,245 @@
+#ifndef _SVRG_TEXTFORMATTING_H_
+#define _SVRG_TEXTFORMATTING_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Functions for writing numbers as text. Each function writes to 'output'
+// without a terminating zero and returns a pointer past the last character.
+// The caller must provide at least MAX_*_LENGTH characters.
+class TextFormatting {
+ public:
+  static constexpr int MAX_INT_LENGTH = 20;
+  static constexpr int MAX_FLOAT_LENGTH = 32;
+
+  static inline char *formatInt(int64_t value, char *output) {
+    uint64_t abs_value = value;
+    if(value < 0) {
+      *output++ = '-';
+      abs_value = -abs_value;
+    }
+    return formatUnsigned(abs_value, output);
+  }
+
+  // Writes the shortest decimal number that reads back (e.g. with strtof)
+  // as exactly 'value'. Numbers between 1e-5 and 1e16 are written in fixed
+  // notation, others in scientific notation.
+  static inline char *formatFloat(float value, char *output);
+
+ private:
+  static inline char *formatUnsigned(uint64_t value, char *output) {
+    static const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233"
+        "34353637383940414243444546474849505152535455565758596061626364656667"
+        "6869707172737475767778798081828384858687888990919293949596979899";
+
+    char digits[MAX_INT_LENGTH];
+    char *ptr = digits + MAX_INT_LENGTH;
+
+    while(value >= 100) {
+      const char *pair = DIGIT_PAIRS + 2 * (value % 100);
+      value /= 100;
+      *--ptr = pair[1];
+      *--ptr = pair[0];
+    }
+
+    if(value >= 10) {
+      const char *pair = DIGIT_PAIRS + 2 * value;
+      *--ptr = pair[1];
+      *--ptr = pair[0];
+    } else {
+      *--ptr = '0' + value;
+    }
+
+    size_t length = digits + MAX_INT_LENGTH - ptr;
+    memcpy(output, ptr, length);
+    return output + length;
+  }
+
+  // Returns true if 'decimal', the correctly rounded double of a decimal
+  // number, is within one double ulp of the midpoint between two floats. The
+  // decimal number could then round to either float.
+  static inline bool nearFloatMidpoint(double decimal) {
+    uint64_t bits;
+    memcpy(&bits, &decimal, sizeof(bits));
+    // A double has 29 more mantissa bits than a float.
+    const uint64_t low_bits = bits & ((1ull << 29) - 1);
+    const uint64_t midpoint = 1ull << 28;
+    return low_bits + 1 >= midpoint && low_bits <= midpoint + 1;
+  }
+
+  static bool readsBackAs(const char *begin, const char *end, float value) {
+    char buffer[MAX_FLOAT_LENGTH + 1];
+    memcpy(buffer, begin, end - begin);
+    buffer[end - begin] = 0;
+    return strtof(buffer, 0) == value;
+  }
+
+  // Writes the number digits * 10^-scale, where digits is not zero.
+  static inline char *formatDecimal(uint64_t digits, int scale, char *output);
+
+  // Used for positive values outside the range of the fast path.
+  static char *formatFloatSlow(float value, char *output) {
+    char buffer[MAX_FLOAT_LENGTH];
+
+    for(int precision = 1; precision <= 9; ++precision) {
+      snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+      if(precision < 9 && strtof(buffer, 0) != value) {continue;}
+
+      // The buffer holds d.ddde[+-]xx
+      uint64_t digits = 0;
+      const char *c = buffer;
+      for(; *c != 'e'; ++c) {
+        if(*c != '.') {digits = digits * 10 + (*c - '0');}
+      }
+
+      return formatDecimal(digits, precision - 1 - atoi(c + 1), output);
+    }
+
+    return output;
+  }
+};
+
+// =================================================================
+// Implementation
+// =================================================================
+
+char *TextFormatting::formatFloat(float value, char *output) {
+  if(std::isnan(value)) {
+    memcpy(output, "nan", 3);
+    return output + 3;
+  }
+
+  if(std::signbit(value)) {
+    *output++ = '-';
+    value = -value;
+  }
+
+  if(std::isinf(value)) {
+    memcpy(output, "inf", 3);
+    return output + 3;
+  }
+
+  if(value == 0.0f) {
+    *output = '0';
+    return output + 1;
+  }
+
+  static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+    1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const double v = value;
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  // floor(log10(2^binary_exponent)), which is either the decimal exponent
+  // of value or one less. Starting one digit early is harmless since
+  // trailing zeros are removed.
+  const int binary_exponent = static_cast<int>(bits >> 23) - 127;
+  const int exponent = (binary_exponent * 78913) >> 18;
+
+  // Powers of 10 up to 1e22 are exact doubles, so that with less than 2^53
+  // digits, scaling by them is correctly rounded. 9 significant digits
+  // always identify a float.
+  if(exponent < -13 || exponent > 21) {return formatFloatSlow(value, output);}
+
+  // Decimal numbers strictly between 'low' and 'high' (the midpoints to the
+  // neighbouring floats, which are exact doubles) read back as 'value'.
+  const uint32_t below_bits = bits - 1, above_bits = bits + 1;
+  float below, above;
+  memcpy(&below, &below_bits, sizeof(below));
+  memcpy(&above, &above_bits, sizeof(above));
+  const double low = (v + below) / 2, high = (v + above) / 2;
+
+  for(int precision = 1; precision <= 10; ++precision) {
+    // Candidates are integers c such that c * 10^-scale has 'precision'
+    // digits.
+    const int scale = precision - 1 - exponent;
+    const double factor = POW10[scale >= 0 ?scale :-scale];
+    const double scaled_low = (scale >= 0) ?low * factor :low / factor;
+    const double scaled_high = (scale >= 0) ?high * factor :high / factor;
+
+    // Scaled bounds are only correct up to rounding errors. Values are
+    // positive, so conversions to integers round down.
+    const double tolerance = scaled_high * 1e-15;
+    const int64_t first = static_cast<int64_t>(scaled_low - tolerance) + 1;
+    const int64_t last = static_cast<int64_t>(scaled_high + tolerance);
+    if(first > last) {continue;}
+
+    // Prefer the candidate closest to value.
+    const double scaled = (scale >= 0) ?v * factor :v / factor;
+    const int64_t nearest = std::min(
+        std::max(static_cast<int64_t>(scaled + 0.5), first), last);
+
+    if(nearest - scaled_low > tolerance && scaled_high - nearest > tolerance) {
+      return formatDecimal(nearest, scale, output);
+    }
+
+    // Candidates close to the bounds are checked exactly.
+    for(int64_t candidate = first - 1; candidate <= last; ++candidate) {
+      const double decimal = (scale >= 0) ?candidate / factor
+          :candidate * factor;
+      if(candidate <= 0 || static_cast<float>(decimal) != value) {continue;}
+
+      char *end = formatDecimal(candidate, scale, output);
+      if(!nearFloatMidpoint(decimal) || readsBackAs(output, end, value)) {
+        return end;
+      }
+    }
+  }
+
+  return formatFloatSlow(value, output);
+}
+
+char *TextFormatting::formatDecimal(uint64_t digits, int scale,
+                                    char *output) {
+  while(digits % 10 == 0) {
+    digits /= 10;
+    --scale;
+  }
+
+  char buffer[MAX_INT_LENGTH];
+  const int num_digits = formatUnsigned(digits, buffer) - buffer;
+  // Number of digits before the decimal point.
+  const int point = num_digits - scale;
+
+  if(point > 16 || point < -4) {
+    *output++ = buffer[0];
+    if(num_digits > 1) {
+      *output++ = '.';
+      memcpy(output, buffer + 1, num_digits - 1);
+      output += num_digits - 1;
+    }
+    *output++ = 'e';
+    return formatInt(point - 1, output);
+  }
+
+  if(point <= 0) {
+    *output++ = '0';
+    *output++ = '.';
+    memset(output, '0', -point);
+    output += -point;
+    memcpy(output, buffer, num_digits);
+    return output + num_digits;
+  }
+
+  if(point >= num_digits) {
+    memcpy(output, buffer, num_digits);
+    output += num_digits;
+    memset(output, '0', point - num_digits);
+    return output + point - num_digits;
+  }
+
+  memcpy(output, buffer, point);
+  output += point;
+  *output++ = '.';
+  memcpy(output, buffer + point, num_digits - point);
+  return output + num_digits - point;
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef _SVRG_TEXTPARSING_H_
+#define _SVRG_TEXTPARSING_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Functions for tokenizing and parsing numbers in text files.
+// Tokens are given as [begin, end) ranges, so no terminating character is
+// needed and the input is never modified.
+class TextParsing {
+ public:
+  // Parses a decimal number with optional sign, fraction and exponent.
+  // The result is correctly rounded. Numbers with at most 19 significant
+  // digits and a small exponent are converted exactly using a single
+  // floating point operation. Other numbers (and inf/nan) fall back to strtod.
+  // Returns false if [begin, end) is not a valid number.
+  static inline bool parseDouble(const char *begin, const char *end,
+                                 double *value);
+
+  // Parses a non-negative decimal integer.
+  // Returns false if [begin, end) is empty or contains a non-digit.
+  static inline bool parseIndex(const char *begin, const char *end,
+                                int *value) {
+    if(begin == end) {return false;}
+    unsigned int output = 0;
+
+    for(; begin < end; ++begin) {
+      unsigned int digit = static_cast<unsigned char>(*begin) - '0';
+      if(digit > 9) {return false;}
+      output = output * 10 + digit;
+    }
+
+    *value = output;
+    return true;
+  }
+
+ private:
+  static bool parseDoubleSlow(const char *begin, const char *end,
+                              double *value) {
+    std::string token(begin, end);
+    char *token_end;
+    *value = strtod(token.c_str(), &token_end);
+    return token_end == token.c_str() + token.size() && !token.empty();
+  }
+};
+
+// Finds the field delimiters (space, tab, carriage return and colon) in a
+// range of characters. The range is scanned in 32 byte (AVX2) or 16 byte
+// (SSE2) blocks, with a scalar fallback when neither is available.
+class DelimiterScanner {
+ public:
+#if defined(__AVX2__)
+  static constexpr int BLOCK_SIZE = 32;
+#elif defined(__SSE2__)
+  static constexpr int BLOCK_SIZE = 16;
+#else
+  static constexpr int BLOCK_SIZE = 32;
+#endif
+
+  DelimiterScanner(const char *begin, const char *end)
+      : block_(begin), end_(end) {
+    mask_ = computeMask(block_);
+  }
+
+  // Returns the position of the next delimiter, or end if there is none.
+  inline const char *next() {
+    while(mask_ == 0) {
+      block_ += BLOCK_SIZE;
+      if(block_ >= end_) {return end_;}
+      mask_ = computeMask(block_);
+    }
+
+    const char *position = block_ + __builtin_ctz(mask_);
+    mask_ &= mask_ - 1;
+    return position;
+  }
+
+  static inline bool isDelimiter(char c) {
+    return c == ' ' || c == ':' || c == '\t' || c == '\r';
+  }
+
+ private:
+  // Returns a bit mask of the delimiters in [block, block + BLOCK_SIZE)
+  // that precede end_.
+  inline uint32_t computeMask(const char *block) const {
+    if(end_ - block < BLOCK_SIZE) {
+      // Do not read past the end of the range.
+      uint32_t mask = 0;
+      for(int i = 0; block + i < end_; ++i) {
+        if(isDelimiter(block[i])) {mask |= 1u << i;}
+      }
+      return mask;
+    }
+
+#if defined(__AVX2__)
+    __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    __m256i match = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(data, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(data, _mm256_set1_epi8(':'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(data, _mm256_set1_epi8('\t')),
+                        _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\r'))));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(match));
+#elif defined(__SSE2__)
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    __m128i match = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(data, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(data, _mm_set1_epi8(':'))),
+        _mm_or_si128(_mm_cmpeq_epi8(data, _mm_set1_epi8('\t')),
+                     _mm_cmpeq_epi8(data, _mm_set1_epi8('\r'))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(match));
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < BLOCK_SIZE; ++i) {
+      if(isDelimiter(block[i])) {mask |= 1u << i;}
+    }
+    return mask;
+#endif
+  }
+
+  const char *block_;
+  const char *end_;
+  uint32_t mask_;
+};
+
+// =================================================================
+// Implementation
+// =================================================================
+
+bool TextParsing::parseDouble(const char *begin, const char *end,
+                              double *value) {
+  // Powers of 10 that are exactly representable as doubles.
+  static const double powers_of_10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char *p = begin;
+  bool negative = false;
+
+  if(p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int num_digits = 0; // Significant digits stored in mantissa
+  int exponent = 0;
+  bool has_digits = false;
+
+  // Integer part
+  for(; p < end; ++p) {
+    unsigned int digit = static_cast<unsigned char>(*p) - '0';
+    if(digit > 9) {break;}
+    has_digits = true;
+    if(mantissa == 0 && digit == 0) {continue;} // Leading zero
+    if(num_digits == 19) {return parseDoubleSlow(begin, end, value);}
+    mantissa = mantissa * 10 + digit;
+    ++num_digits;
+  }
+
+  // Fraction
+  if(p < end && *p == '.') {
+    for(++p; p < end; ++p) {
+      unsigned int digit = static_cast<unsigned char>(*p) - '0';
+      if(digit > 9) {break;}
+      has_digits = true;
+      --exponent;
+      if(mantissa == 0 && digit == 0) {continue;} // Leading zero
+      if(num_digits == 19) {return parseDoubleSlow(begin, end, value);}
+      mantissa = mantissa * 10 + digit;
+      ++num_digits;
+    }
+  }
+
+  if(!has_digits) {return parseDoubleSlow(begin, end, value);}
+
+  // Exponent
+  if(p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exponent = false;
+
+    if(p < end && (*p == '-' || *p == '+')) {
+      negative_exponent = (*p == '-');
+      ++p;
+    }
+
+    if(p == end) {return false;}
+    int explicit_exponent = 0;
+
+    for(; p < end; ++p) {
+      unsigned int digit = static_cast<unsigned char>(*p) - '0';
+      if(digit > 9) {return false;}
+      if(explicit_exponent < 100000) {
+        explicit_exponent = explicit_exponent * 10 + digit;
+      }
+    }
+
+    exponent += negative_exponent ?-explicit_exponent :explicit_exponent;
+  }
+
+  if(p != end) {return false;}
+
+  double output;
+
+  if(mantissa == 0) {
+    output = 0.0;
+  } else if(mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+    // Both the mantissa and the power of 10 are exact, so a single
+    // multiplication or division gives a correctly rounded result.
+    output = static_cast<double>(mantissa);
+    if(exponent < 0) {output /= powers_of_10[-exponent];}
+    else {output *= powers_of_10[exponent];}
+  } else {
+    return parseDoubleSlow(begin, end, value);
+  }
+
+  *value = negative ?-output :output;
+  return true;
+}
+
+#endif
@@ -1,29 +1,41 @@
 #ifndef _SVRG_VECTOR_H
 #define _SVRG_VECTOR_H
 
+#include <algorithm>
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 
-// Dense vector
-class Vector : public std::vector<double> {
+#include "HugePages.h"
+
+// Dense vector of values of type T (double or float). Reductions such as
+// dot products are computed in double precision. Large vectors are on huge
+// pages if enabled (see HugePages).
+template<class T>
+class BasicVector : public std::vector<T, HugePageAllocator<T>> {
  public:
   typedef size_t Index;
   
-  Vector() {}
-  Vector(Index size)
-      : vector<double>(size) {}
+  BasicVector() {}
+  BasicVector(Index size)
+      : std::vector<T, HugePageAllocator<T>>(size) {}
   
-  void fill(double value) {
-    std::fill(begin(), end(), 0.0);
+  void fill(T value) {
+    std::fill(this->begin(), this->end(), 0.0);
   }
 
-  double dot(const Vector &other) const {
+  double dot(const BasicVector &other) const {
     double output = 0.0;
-    for(Index i = 0; i < size(); ++i) {output += (*this)[i] * other[i];}
+    for(Index i = 0; i < this->size(); ++i) {
+      output += static_cast<double>((*this)[i]) * other[i];
+    }
     return output;
   }
 };
 
+typedef BasicVector<double> Vector;
+typedef BasicVector<float> FloatVector;
+
 // Read iterator for sparse vectors.
 // Can be specified for each class that represents
 // a sparse vector (See VectorIterator<SparseVec> below).
@@ -60,78 +72,137 @@ class ModifyingVectorIterator : public VectorIterator<IterableVector> {
   double &valueRef() const;
 };
 
-// Sparse Vector
-class SparseVec {
+// Sparse vector of values of type T (double or float). Indices and values
+// are stored in separate arrays, so that a non-zero entry takes 4 bytes plus
+// the size of T and indices can be loaded (e.g. gathered) on their own.
+template<class T>
+class BasicSparseVec {
  public:
-  typedef size_t Index;
-  typedef std::vector<std::pair<Index, double>> InnerStorage;
+  typedef uint32_t Index;
+  typedef T value_type;
   
-  SparseVec() {}
-  SparseVec(size_t size) {
-    map_.reserve(size);
+  BasicSparseVec() {}
+  BasicSparseVec(size_t size) {
+    reserve(size);
   }
-  
+
+  // Copies hold only the set entries.
+  BasicSparseVec(const BasicSparseVec &other)
+      : size_(other.size_),
+        indices_(other.indices_.begin(), other.indices_.begin() + size_),
+        values_(other.values_.begin(), other.values_.begin() + size_) {}
+
+  BasicSparseVec(BasicSparseVec &&other)
+      : size_(other.size_), indices_(std::move(other.indices_)),
+        values_(std::move(other.values_)) {
+    other.size_ = 0;
+  }
+
+  BasicSparseVec &operator=(const BasicSparseVec &other) {
+    if(this == &other) {return *this;}
+    reserve(other.size_);
+    std::copy(other.indices_.begin(), other.indices_.begin() + other.size_,
+              indices_.begin());
+    std::copy(other.values_.begin(), other.values_.begin() + other.size_,
+              values_.begin());
+    size_ = other.size_;
+    return *this;
+  }
+
+  BasicSparseVec &operator=(BasicSparseVec &&other) {
+    std::swap(size_, other.size_);
+    indices_.swap(other.indices_);
+    values_.swap(other.values_);
+    return *this;
+  }
+
   void addElement(Index index, double value) {
-    ASSERT(map_.size() == 0 || map_.back().first < index,
+    ASSERT(size_ == 0 || indices_[size_ - 1] < index,
            "Out of order insertion");
-    map_.push_back(std::pair<Index, double>(index, value));
+    if(size_ == indices_.size()) {reserve(std::max<size_t>(2 * size_, 16));}
+    indices_[size_] = index;
+    values_[size_] = value;
+    ++size_;
   }
 
-  void clear() {map_.clear();}
-  void reserve(size_t size) {map_.reserve(size);}
-  size_t size() const {return map_.size();}
+  void clear() {size_ = 0;}
 
-  InnerStorage::iterator begin() {return map_.begin();}
-  InnerStorage::iterator end() {return map_.end();}
-  InnerStorage::const_iterator begin() const {return map_.begin();}
-  InnerStorage::const_iterator end() const {return map_.end();}
+  void reserve(size_t size) {
+    if(size <= indices_.size()) {return;}
+    indices_.resize(size);
+    values_.resize(size);
+  }
+
+  size_t size() const {return size_;}
+
+  const Index *indices() const {return indices_.data();}
+  const T *values() const {return values_.data();}
+  T *values() {return values_.data();}
   
  private:
-  InnerStorage map_;
-
-  friend class VectorIterator<SparseVec>;
-  friend class ModifyingVectorIterator<SparseVec>;
+  // Entries [0, size_) are set; the arrays are resized only to grow, so
+  // that vectors reused for every example or gradient stop allocating.
+  size_t size_ = 0;
+  std::vector<Index> indices_;
+  std::vector<T> values_;
 };
 
+typedef BasicSparseVec<double> SparseVec;
+typedef BasicSparseVec<float> FloatSparseVec;
+
 struct ScaledSparseVec {
-  typedef size_t Index;
+  typedef SparseVec::Index Index;
   double scale;
   const SparseVec *vector;
 };
 
-template<>
-class VectorIterator<SparseVec> {
+template<class T>
+class VectorIterator<BasicSparseVec<T>> {
  public:
-  VectorIterator(const SparseVec &vector)
-      : iterator_(vector.map_.begin()), end_iterator_(vector.map_.end()) {}
+  typedef typename BasicSparseVec<T>::Index Index;
+
+  VectorIterator(const BasicSparseVec<T> &vector)
+      : index_(vector.indices()), value_(vector.values()),
+        end_(vector.indices() + vector.size()) {}
   
-  int index() const {return iterator_->first;}
-  double value() const {return iterator_->second;}
+  Index index() const {return *index_;}
+  double value() const {return *value_;}
   
-  operator bool() const {return iterator_ != end_iterator_;}
-  void next() {++iterator_;}
+  operator bool() const {return index_ != end_;}
+  void next() {
+    ++index_;
+    ++value_;
+  }
 
 private:
-  SparseVec::InnerStorage::const_iterator iterator_;
-  SparseVec::InnerStorage::const_iterator end_iterator_;
+  const Index *index_;
+  const T *value_;
+  const Index *end_;
 };
 
-template<>
-class ModifyingVectorIterator<SparseVec> {
+template<class T>
+class ModifyingVectorIterator<BasicSparseVec<T>> {
  public:
-  ModifyingVectorIterator(SparseVec &vector)
-      : iterator_(vector.map_.begin()), end_iterator_(vector.map_.end()) {}
-  
-  int index() const {return iterator_->first;}
-  double value() const {return iterator_->second;}
-  double &valueRef() const {return iterator_->second;}
+  typedef typename BasicSparseVec<T>::Index Index;
 
-  operator bool() const {return iterator_ != end_iterator_;}
-  void next() {++iterator_;}
+  ModifyingVectorIterator(BasicSparseVec<T> &vector)
+      : index_(vector.indices()), value_(vector.values()),
+        end_(vector.indices() + vector.size()) {}
+  
+  Index index() const {return *index_;}
+  double value() const {return *value_;}
+  T &valueRef() const {return *value_;}
+
+  operator bool() const {return index_ != end_;}
+  void next() {
+    ++index_;
+    ++value_;
+  }
 
 private:
-  SparseVec::InnerStorage::iterator iterator_;
-  SparseVec::InnerStorage::iterator end_iterator_;
+  const Index *index_;
+  T *value_;
+  const Index *end_;
 };
 
 template<>
@@ -141,7 +212,7 @@ class VectorIterator<ScaledSparseVec> {
       : iterator_(*vector.vector),
         scale_(vector.scale) {}
   
-  int index() const {return iterator_.index();}
+  ScaledSparseVec::Index index() const {return iterator_.index();}
   double value() const {return scale_ * iterator_.value();}
   
   operator bool() const {return iterator_;}
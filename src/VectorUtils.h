@@ -1,8 +1,11 @@
 #ifndef _SVRG_VECTORUTILS_H_
 #define _SVRG_VECTORUTILS_H_
 
-#include "Vector.h"
+#include "CSRDataset.h"
 #include "Platform.h"
+#include "SVRGParamVector.h"
+#include "SparseKernels.h"
+#include "Vector.h"
 
 // This class provides utility functions for vector operations.
 // It supports arbitrary representation for dense and sparse vectors.
@@ -10,7 +13,40 @@
 // access elements.
 // A sparse vector has to support VectorIterator (and ModVectorIterator if
 // write access is needed) defined in Vector.h
+//
+// Sparse vectors stored as index and value arrays (BasicSparseVec,
+// CSRRowView) combined with contiguous dense vectors (BasicVector,
+// BasicSVRGParamVector) use the SIMD kernels of SparseKernels.
 class VectorUtils {
+ private:
+  // Index and value arrays of a sparse vector, whose values are multiplied
+  // by scale.
+  template<class Value>
+  struct SparseArrays {
+    const int32_t *indices;
+    const Value *values;
+    size_t size;
+    double scale;
+  };
+
+  template<class T>
+  static SparseArrays<T> sparseArrays(const BasicSparseVec<T> &sparse) {
+    return {reinterpret_cast<const int32_t *>(sparse.indices()),
+            sparse.values(), sparse.size(), 1.0};
+  }
+
+  static SparseArrays<float> sparseArrays(const CSRRowView &sparse) {
+    return {sparse.indices, sparse.values, sparse.size(), sparse.scale};
+  }
+
+  // Computes output[j] = <sparse, dense[j]> for N dense arrays.
+  template<int N, class Value, class Real>
+  static void kernelDot(const SparseArrays<Value> &sparse,
+                        const Real *const *dense, double *output) {
+    SparseKernels::dot<N>(sparse.indices, sparse.values, sparse.size,
+                          sparse.scale, dense, output);
+  }
+
 public:  
   // Computes self := self * self_scale + other * other_scale
   template<class DenseVector>
@@ -31,7 +67,7 @@ public:
                         const DenseVector &increment,
                         bool atomicComponentUpdates) {
     if(atomicComponentUpdates) {
-      double *raw = v.data();
+      typename DenseVector::value_type *raw = v.data();
       int n = v.size();
 
       for(int i = 0; i < n; i++) {
@@ -47,12 +83,26 @@ public:
   }
 
   // Same as above but with for a sparse increment vector.
+  template<class Real, class IterableVector>
+  static auto addVector(BasicVector<Real> &v, const IterableVector &increment,
+                        double scale, bool atomicComponentUpdates)
+      -> decltype(sparseArrays(increment), void()) {
+    if(atomicComponentUpdates) {
+      addVector<BasicVector<Real>, IterableVector>(v, increment, scale, true);
+      return;
+    }
+
+    auto sparse = sparseArrays(increment);
+    SparseKernels::axpy(sparse.indices, sparse.values, sparse.size,
+                        sparse.scale, scale, v.data());
+  }
+
   template<class DenseVector, class IterableVector>
   static void addVector(DenseVector &v,
                  const IterableVector &increment,
                  double scale,
                  bool atomicComponentUpdates) {
-    double *raw = v.data();
+    typename DenseVector::value_type *raw = v.data();
     VectorIterator<IterableVector> iterator(increment);
 
     if(atomicComponentUpdates) {
@@ -68,10 +118,10 @@ public:
     }
   }
 
-  template<class IterableVector1, class IterableVector2>
+  template<class IterableVector1, class IterableVector2, class T>
   static void addVector(const IterableVector1 &v1,
                         const IterableVector2 &v2,
-                        SparseVec &output) {
+                        BasicSparseVec<T> &output) {
     output = v1;
     return;
     
@@ -105,6 +155,20 @@ public:
     }
   }
 
+  // Computes output := v * scale, where v is a sparse vector.
+  template<class IterableVector, class T>
+  static void scaledCopy(const IterableVector &v, double scale,
+                         BasicSparseVec<T> &output) {
+    output.clear();
+    output.reserve(v.size());
+
+    VectorIterator<IterableVector> iterator(v);
+
+    for(; iterator; iterator.next()) {
+      output.addElement(iterator.index(), iterator.value() * scale);
+    }
+  }
+
   // Computes self := self * self_scale + other * other_scale
   // where self and other are two compatible sparse vectors.
   // Two sparse vectors are compatible if both have the same non-zero indices.
@@ -156,6 +220,84 @@ public:
 
     return output;
   }
+
+  template<class IterableVector, class Real>
+  static auto sparseDot(const IterableVector &sparse,
+                        const BasicVector<Real> &other)
+      -> decltype(sparseArrays(sparse), double()) {
+    const Real *dense[] = {other.data()};
+    double output;
+    kernelDot<1>(sparseArrays(sparse), dense, &output);
+    return output;
+  }
+
+  template<class IterableVector, class Real>
+  static auto sparseDot(const IterableVector &sparse,
+                        const BasicSVRGParamVector<Real> &other)
+      -> decltype(sparseArrays(sparse), double()) {
+    if(other.avg_gradient_multiple == 0.0) {
+      return sparseDot(sparse, *other.x);
+    }
+
+    const Real *dense[] = {other.x->data(), other.avg_gradient->data()};
+    double output[2];
+    kernelDot<2>(sparseArrays(sparse), dense, output);
+    return output[0] + other.avg_gradient_multiple * output[1];
+  }
+
+  // Computes the dot products of a sparse vector with two vectors in a
+  // single pass over the sparse vector.
+  template<class IterableVector, class DenseVector1, class DenseVector2>
+  static void sparseDots(
+      const IterableVector &sparse, const DenseVector1 &first,
+      const DenseVector2 &second, double *first_dot, double *second_dot) {
+    VectorIterator<IterableVector> sparse_iterator(sparse);
+
+    double output1 = 0.0;
+    double output2 = 0.0;
+
+    for(; sparse_iterator; sparse_iterator.next()) {
+      const double value = sparse_iterator.value();
+      output1 += value * first[sparse_iterator.index()];
+      output2 += value * second[sparse_iterator.index()];
+    }
+
+    *first_dot = output1;
+    *second_dot = output2;
+  }
+
+  template<class IterableVector, class Real>
+  static auto sparseDots(
+      const IterableVector &sparse, const BasicVector<Real> &first,
+      const BasicVector<Real> &second, double *first_dot, double *second_dot)
+      -> decltype(sparseArrays(sparse), void()) {
+    const Real *dense[] = {first.data(), second.data()};
+    double output[2];
+    kernelDot<2>(sparseArrays(sparse), dense, output);
+    *first_dot = output[0];
+    *second_dot = output[1];
+  }
+
+  // SVRG parameters at the current and the last iterate share the average
+  // gradient, so both dot products read three dense arrays.
+  template<class IterableVector, class Real>
+  static auto sparseDots(
+      const IterableVector &sparse, const BasicSVRGParamVector<Real> &first,
+      const BasicSVRGParamVector<Real> &second, double *first_dot,
+      double *second_dot) -> decltype(sparseArrays(sparse), void()) {
+    if(first.avg_gradient != second.avg_gradient) {
+      *first_dot = sparseDot(sparse, first);
+      *second_dot = sparseDot(sparse, second);
+      return;
+    }
+
+    const Real *dense[] = {first.x->data(), second.x->data(),
+                           first.avg_gradient->data()};
+    double output[3];
+    kernelDot<3>(sparseArrays(sparse), dense, output);
+    *first_dot = output[0] + first.avg_gradient_multiple * output[2];
+    *second_dot = output[1] + second.avg_gradient_multiple * output[2];
+  }
 };
 
 #endif
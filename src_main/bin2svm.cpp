@@ -1,78 +1,119 @@
-// Convert SVM file format to Binary file format for fast reading.
-// The format is as follows:
-// Number of examples (64-bit integer)
-// Number of features (32-bit integer)
-// Examples where each examples is:
-// - Label (1 byte)
-// - Number of non-zero features (32-bit integer)
-// - Non-zero features where each feature is:
-//   * Feature index (32-bit integer)
-//   * Feature value (32-bit float)
-
-#include<unistd.h>
-#include<fcntl.h>
-
+// Convert a binary data file (version 1 or 2, see svm2bin.cpp) to LIBSVM
+// format.
+//
+// Usage: bin2svm <input_binary_file> [--output=<file>] [--num_threads=<n>]
+// The output is written to the standard output unless --output is given.
+// Examples are read in batches, each of which is formatted in parallel by
+// all threads (or --num_threads threads) into separate buffers that are
+// written in order by a background thread. Values are written with the
+// fewest digits that read back as the same 32-bit float.
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "AsyncFileWriter.h"
+#include "CommandLineArgsReader.h"
+#include "CSRDataset.h"
 #include "Platform.h"
 #include "DataReader.h"
-
-int fd;
-const int BUFFER_SIZE = 16 * 1024;
-char buffer[BUFFER_SIZE];
-char * const buffer_end = buffer + BUFFER_SIZE;
-char *ptr = buffer;
-
-inline void writeBuffer() {
-	int flag = write(fd, buffer, ptr-buffer);
-        ASSERT(flag > 0, "");
-	ptr = buffer;
-}
-
-inline void checkBuffer(int size) {
-	if (ptr + size > buffer_end) {
-		writeBuffer();
+#include "TextFormatting.h"
+
+// A batch is formatted once it holds this many non-zero features.
+const size_t BATCH_NONZERO = 1024 * 1024;
+
+// Formats examples [begin, end) of 'batch' as LIBSVM lines into 'output'.
+void formatExamples(const CSRDataset &batch, size_t begin, size_t end,
+					std::vector<char> *output) {
+	const size_t *row_offsets = batch.row_offsets_data();
+	const int *indices = batch.indices_data();
+	const float *values = batch.values_data();
+	const double *labels = batch.labels().data();
+
+	const size_t num_nonzero = row_offsets[end] - row_offsets[begin];
+	output->resize((end - begin) * (TextFormatting::MAX_INT_LENGTH + 1) +
+				   num_nonzero * (TextFormatting::MAX_INT_LENGTH +
+								  TextFormatting::MAX_FLOAT_LENGTH + 2));
+	char *ptr = output->data();
+
+	for (size_t i = begin; i < end; ++i) {
+		ptr = TextFormatting::formatInt(static_cast<int64_t>(labels[i]), ptr);
+
+		for (size_t j = row_offsets[i]; j < row_offsets[i+1]; ++j) {
+			*ptr++ = ' ';
+			ptr = TextFormatting::formatInt(indices[j], ptr);
+			*ptr++ = ':';
+			ptr = TextFormatting::formatFloat(values[j], ptr);
+		}
+
+		*ptr++ = '\n';
 	}
+
+	output->resize(ptr - output->data());
 }
 
-int main(int argc, char **argv) {
-	ASSERT(argc == 2, "Invalid number of parameters");
+int main(int argc, const char **argv) {
+	ASSERT(argc >= 2, "Invalid number of parameters");
 	const char *input = argv[1];
-	
+
 	Platform::init();
-	
+
+	CommandLineArgsReader args;
+	args.read(argc, argv);
+	int num_threads = atoi(args.getParam("--num_threads", "0").c_str());
+	if (num_threads > 0) { Platform::setNumLocalThreads(num_threads); }
+	std::string output = args.getParam("--output", "-");
+
 	BinaryDataReader reader(input);
+	reader.setPrefetch(BinaryDataReader::DEFAULT_PREFETCH_DEPTH,
+					   BinaryDataReader::DEFAULT_PREFETCH_BUFFER_SIZE);
 	bool open_input = reader.init();
 	ASSERT(open_input, "Could not open input file");
 
-	SparseExample example;
+	AsyncFileWriter writer;
+	bool open_output = writer.open(output);
+	ASSERT(open_output, "Could not open output file " << output);
 
+	const int num_ranges = Platform::getNumLocalThreads();
+	std::vector<std::vector<char>> buffers(num_ranges);
+
+	SparseExample example;
+	CSRDataset batch;
 	BinExampleCount num_examples = 0;
-	SparseExample::Index max_feature_id = 0;
+	bool has_more = true;
 
 	auto start_time = Platform::getCurrentTime();
 
-	while(reader.read(&example)) {
-		// Output label
-		std::cout << example.label << " ";
-
-		// Ouptut non-zero features
-		VectorIterator<SparseVec> iterator(example.feats);
-
-		for(; iterator; iterator.next()) {
-		  std::cout << iterator.index() << ":" << iterator.value() << " ";
-		}	  
-
-		std::cout << "\n";
-		
-		++num_examples;
-		if (num_examples % 1000 == 0) { LOG(num_examples); }
+	while (has_more) {
+		batch.clear();
+		while (batch.num_nonzero() < BATCH_NONZERO &&
+			   (has_more = reader.read(&example))) {
+			batch.addExample(example.feats, example.label);
+		}
+
+		const size_t batch_size = batch.size();
+		if (batch_size == 0) { break; }
+
+		#pragma omp parallel for schedule(static, 1)
+		for (int r = 0; r < num_ranges; ++r) {
+			size_t begin = batch_size * r / num_ranges;
+			size_t end = batch_size * (r + 1) / num_ranges;
+			formatExamples(batch, begin, end, &buffers[r]);
+		}
+
+		for (const std::vector<char> &buffer : buffers) {
+			writer.write(buffer.data(), buffer.size());
+		}
+
+		num_examples += batch_size;
+		LOG(num_examples);
 	}
 
-	// Write number of examples and number of features
-	++max_feature_id;
+	writer.close();
 
 	auto end_time = Platform::getCurrentTime();
 
 	LOG("Time: " << Platform::getDurationms(start_time, end_time) << "ms");
 	LOG("Number of examples: " << num_examples);
-	LOG("Number of features: " << max_feature_id);
+	LOG("Number of features: " << reader.num_features());
 }
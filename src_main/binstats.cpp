@@ -0,0 +1,39 @@
+// Computes statistics of a binary data file (version 1 or 2) that train_lr
+// otherwise computes on every run: the L2 norm of every example and the
+// number of examples where each feature is not zero (see DatasetStats.h).
+//
+// Usage: binstats <input_binary_file> [--output=<file>]
+// By default the statistics are written to <input_binary_file>.stats, where
+// train_lr finds them. The file must be recomputed when the data changes,
+// train_lr ignores statistics of a different file.
+
+#include "CommandLineArgsReader.h"
+#include "DatasetStats.h"
+#include "Platform.h"
+
+int main(int argc, const char **argv) {
+	ASSERT(argc >= 2, "Invalid number of parameters");
+	const std::string input = argv[1];
+
+	Platform::init();
+
+	CommandLineArgsReader args;
+	args.read(argc, argv);
+	std::string output = args.getParam("--output",
+									   DatasetStats::sidecarName(input));
+
+	auto start_time = Platform::getCurrentTime();
+
+	DatasetStats stats;
+	bool computed = stats.compute(input);
+	ASSERT(computed, "Could not read input file " << input);
+
+	bool written = stats.write(output);
+	ASSERT(written, "Could not write output file " << output);
+
+	auto end_time = Platform::getCurrentTime();
+
+	LOG("Time: " << Platform::getDurationms(start_time, end_time) << "ms");
+	LOG("Number of examples: " << stats.num_examples());
+	LOG("Number of features: " << stats.num_features());
+}
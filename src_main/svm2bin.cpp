@@ -8,100 +8,189 @@
 // - Non-zero features where each feature is:
 //   * Feature index (32-bit integer)
 //   * Feature value (32-bit float)
-
-#include<unistd.h>
-#include<fcntl.h>
-
+//
+// This is version 1 of the format. By default the output is written in
+// version 2 format, which stores examples in blocks (see BinaryFormat.h).
+//
+// Usage: svm2bin <input_svm_file> <output_binary_file> [--num_threads=<n>]
+//                [--format=<1|2>] [--examples_per_block=<n>]
+//                [--varint_indices=<0|1>] [--value_bits=<32|16|8>]
+// --varint_indices and --value_bits compress version 2 files. Values with
+// fewer than 32 bits are lossy.
+// The input is parsed in parallel by all threads. Use "-" as input file to
+// read from the standard input (e.g. zcat data.svm.gz | svm2bin - data.bin).
+// The output is written by a background thread in large buffers, and must be
+// a regular file since the header is written last.
+//
+// Features can be renumbered (see FeatureMap.h):
+// --feature_order=frequency numbers features by descending number of
+//   occurrences, so that frequently used parameters share cache lines during
+//   training. Examples are converted with their original indices into a
+//   temporary file, which is then rewritten with the new indices.
+// --min_feature_count=<n> additionally drops features with fewer than n
+//   occurrences (with --feature_order=frequency).
+// --save_feature_map=<file> saves the new numbering.
+// --feature_map=<file> applies a saved numbering, e.g. to convert a test set
+//   consistently with its training set. Features that are not in the map are
+//   dropped.
+
+#include <cstdlib>
+#include <vector>
+
+#include "BinaryDataWriter.h"
+#include "CommandLineArgsReader.h"
+#include "FeatureMap.h"
 #include "Platform.h"
 #include "DataReader.h"
 
-int fd;
-const int BUFFER_SIZE = 16 * 1024;
-char buffer[BUFFER_SIZE];
-char * const buffer_end = buffer + BUFFER_SIZE;
-char *ptr = buffer;
+// Rewrites a binary file with features renumbered by 'feature_map'.
+void remapFile(const std::string &input, const std::string &output,
+			   const FeatureMap &feature_map, int format,
+			   int examples_per_block, uint32_t flags) {
+	BinaryDataReader reader(input);
+	reader.setPrefetch(BinaryDataReader::DEFAULT_PREFETCH_DEPTH,
+					   BinaryDataReader::DEFAULT_PREFETCH_BUFFER_SIZE);
+	bool open_input = reader.init();
+	ASSERT(open_input, "Could not open " << input);
+	BinaryDataWriter writer(output, format, examples_per_block, flags);
+	bool open_output = writer.open();
+	ASSERT(open_output, "Could not open output file");
 
-inline void writeBuffer() {
-	int flag = write(fd, buffer, ptr-buffer);
-        ASSERT(flag > 0, "");
-	ptr = buffer;
-}
+	SparseExample example;
+	SparseVec remapped;
 
-inline void checkBuffer(int size) {
-	if (ptr + size > buffer_end) {
-		writeBuffer();
+	while (reader.read(&example)) {
+		feature_map.apply(example.feats, &remapped);
+		writer.write(remapped, example.label);
 	}
+
+	writer.set_min_num_features(feature_map.num_features());
+	reader.close();
+	writer.close();
 }
 
-int main(int argc, char **argv) {
-	ASSERT(argc == 3, "Invalid number of parameters");
+int main(int argc, const char **argv) {
+	ASSERT(argc >= 3, "Invalid number of parameters");
 	const char *input = argv[1];
 	const char *output = argv[2];
-	
+
 	Platform::init();
-	
-	SVMDataReader reader(input);
-	//BinaryDataReader reader(input);
+
+	CommandLineArgsReader args;
+	args.read(argc, argv);
+	int num_threads = atoi(args.getParam("--num_threads", "0").c_str());
+	if (num_threads > 0) { Platform::setNumLocalThreads(num_threads); }
+
+	int format = atoi(args.getParam("--format", "2").c_str());
+	int examples_per_block = atoi(args.getParam(
+		"--examples_per_block",
+		std::to_string(BinaryDataWriter::DEFAULT_EXAMPLES_PER_BLOCK)).c_str());
+
+	uint32_t flags = 0;
+	if (atoi(args.getParam("--varint_indices", "0").c_str())) {
+		flags |= BIN_V2_VARINT_INDICES;
+	}
+	int value_bits = atoi(args.getParam("--value_bits", "32").c_str());
+	ASSERT(value_bits == 32 || value_bits == 16 || value_bits == 8,
+		   "Invalid --value_bits " << value_bits);
+	if (value_bits == 16) { flags |= BIN_V2_FLOAT16_VALUES; }
+	if (value_bits == 8) { flags |= BIN_V2_UINT8_VALUES; }
+
+	std::string feature_order = args.getParam("--feature_order", "input");
+	ASSERT(feature_order == "input" || feature_order == "frequency",
+		   "Invalid --feature_order " << feature_order);
+	const bool by_frequency = feature_order == "frequency";
+	int64_t min_feature_count = atoll(
+		args.getParam("--min_feature_count", "0").c_str());
+	ASSERT(min_feature_count <= 1 || by_frequency,
+		   "--min_feature_count requires --feature_order=frequency");
+	std::string feature_map_file = args.getParam("--feature_map", "");
+	std::string save_feature_map = args.getParam("--save_feature_map", "");
+	ASSERT(!(by_frequency && feature_map_file != ""),
+		   "--feature_map and --feature_order=frequency are exclusive");
+
+	FeatureMap feature_map;
+	if (feature_map_file != "") {
+		bool read_map = feature_map.read(feature_map_file);
+		ASSERT(read_map, "Could not read feature map " << feature_map_file);
+	}
+
+	// With frequency order, features are counted while writing a temporary
+	// file, which is then renumbered.
+	std::string first_output = by_frequency
+		? std::string(output) + ".unmapped" : std::string(output);
+
+	ParallelSVMDataReader reader(input);
 	bool open_input = reader.init();
 	ASSERT(open_input, "Could not open input file");
-	fd = open(output, O_CREAT | O_WRONLY | O_TRUNC | O_LARGEFILE, 0644);
-	ASSERT(fd >= 0, "Could not open output file");
-
-	SparseExample example;
+	BinaryDataWriter writer(first_output, by_frequency ? 2 : format,
+							examples_per_block, by_frequency ? 0 : flags);
+	bool open_output = writer.open();
+	ASSERT(open_output, "Could not open output file");
 
-	BinExampleCount num_examples = 0;
-	SparseExample::Index max_feature_id = 0;
-	ptr = buffer + sizeof(BinExampleCount) + sizeof(SparseExample::Index);
+	std::vector<CSRDataset> chunks;
+	std::vector<CSRDataset> remapped_chunks;
+	std::vector<int64_t> feature_counts;
+	SparseVec remapped;
 
 	auto start_time = Platform::getCurrentTime();
 
-	while(reader.read(&example)) {
-		// Output label
-		checkBuffer(sizeof(BinLabel));
-		*reinterpret_cast<BinLabel *>(ptr) = example.label;
-		ptr += sizeof(BinLabel);
-
-		// Output number of non-zero features
-		checkBuffer(sizeof(BinNZFeatCount));
-		*reinterpret_cast<BinNZFeatCount *>(ptr) = 
-                    static_cast<BinNZFeatCount>(example.feats.size());
-		ptr += sizeof(BinNZFeatCount);
-
-		// Ouptut non-zero features
-		VectorIterator<SparseVec> iterator(example.feats);
-
-		for(; iterator; iterator.next()) {
-                  checkBuffer(sizeof(SparseExample::Index) + sizeof(float));
-                  *reinterpret_cast<SparseExample::Index *>(ptr) =
-                      iterator.index();
-                  ptr += sizeof(SparseExample::Index);
-                  *reinterpret_cast<float *>(ptr) = iterator.value();
-                  ptr += sizeof(float);
-
-                  if (iterator.index() > max_feature_id) {
-                    max_feature_id = iterator.index();
-                  }
-		}	  
-		
-		++num_examples;
-		if (num_examples % 1000 == 0) { LOG(num_examples); }
+	while (reader.read(&chunks)) {
+		if (by_frequency) {
+			for (const CSRDataset &chunk : chunks) {
+				const int *indices = chunk.indices_data();
+				for (size_t j = 0; j < chunk.num_nonzero(); ++j) {
+					if ((size_t) indices[j] >= feature_counts.size()) {
+						feature_counts.resize(indices[j] + 1, 0);
+					}
+					++feature_counts[indices[j]];
+				}
+			}
+		}
+
+		// The writer serializes the blocks of all chunks in parallel.
+		if (feature_map_file != "") {
+			remapped_chunks.resize(chunks.size());
+			for (size_t c = 0; c < chunks.size(); ++c) {
+				remapped_chunks[c].clear();
+				for (size_t i = 0; i < chunks[c].size(); ++i) {
+					feature_map.apply(chunks[c][i], &remapped);
+					remapped_chunks[c].addExample(remapped, chunks[c].labels()[i]);
+				}
+			}
+			writer.write(remapped_chunks);
+		} else {
+			writer.write(chunks);
+		}
+		LOG(writer.num_examples());
 	}
 
-	writeBuffer();
+	if (feature_map_file != "") {
+		writer.set_min_num_features(feature_map.num_features());
+	}
+
+	reader.close();
+	writer.close();
 
-	// Write number of examples and number of features
-	++max_feature_id;
-	lseek(fd, 0, SEEK_SET);
-        int flag = write(
-            fd, reinterpret_cast<char *>(&num_examples), sizeof(num_examples));
-	flag |= write(
-            fd, reinterpret_cast<char *>(&max_feature_id), sizeof(max_feature_id));
-        ASSERT(flag > 0, "");
-	close(fd);
+	if (by_frequency) {
+		feature_map = FeatureMap::byFrequency(feature_counts, min_feature_count);
+		LOG("Kept " << feature_map.num_features() << " of "
+			<< feature_counts.size() << " features");
+		remapFile(first_output, output, feature_map, format, examples_per_block,
+				  flags);
+		remove(first_output.c_str());
+	}
+
+	if (save_feature_map != "") {
+		bool saved = feature_map.write(save_feature_map);
+		ASSERT(saved, "Could not write feature map " << save_feature_map);
+	}
 
 	auto end_time = Platform::getCurrentTime();
 
 	LOG("Time: " << Platform::getDurationms(start_time, end_time) << "ms");
-	LOG("Number of examples: " << num_examples);
-	LOG("Number of features: " << max_feature_id);
+	LOG("Number of examples: " << writer.num_examples());
+	LOG("Number of features: " << (by_frequency || feature_map_file != ""
+								   ? feature_map.num_features()
+								   : writer.num_features()));
 }
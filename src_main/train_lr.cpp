@@ -6,7 +6,15 @@
 #include "CommandLineArgsReader.h"
 #include "Platform.h"
 #include "BatchOracle.h"
+#include "DatasetStats.h"
+#include "ExampleOrder.h"
+#include "HugePages.h"
+#include "IndexedDataset.h"
 #include "LogisticRegressionOracle.h"
+#include "MappedDataset.h"
+#include "MulticlassLogisticRegressionOracle.h"
+#include "SparseKernels.h"
+#include "StreamingDataset.h"
 
 #include "SGDSolver.h"
 #include "SVRGSolver.h"
@@ -16,6 +24,10 @@ void fillOptions(const CommandLineArgsReader &args, typename Solver::Options *op
   double step = atof(args.getParam("--step", "1e-4").c_str());
   double alpha = atof(args.getParam("--alpha", "-1").c_str());
   ParallelMode parallel_mode = ParallelMode::fromString(args.getParam("--pmode", "FREE_FOR_ALL").c_str());
+  SamplingMode sampling_mode = SamplingMode::fromString(
+      args.getParam("--sampling", "UNIFORM").c_str());
+  NumaMode numa_mode = NumaMode::fromString(
+      args.getParam("--numa", "NONE").c_str());
   int max_epochs = atoi(args.getParam("--max_epochs", "1000").c_str()); //Use -1 for unlimited
   int num_nupdates_per_epoch = atoi(args.getParam("--nupd", "1").c_str());
     
@@ -30,106 +42,394 @@ void fillOptions(const CommandLineArgsReader &args, typename Solver::Options *op
   options->step = step;
   options->alpha_step = alpha;
   options->parallel_mode = parallel_mode;
+  options->sampling_mode = sampling_mode;
+  options->numa_mode = numa_mode;
   options->target_objective = target_objective;
   options->max_num_epochs = max_epochs;
   options->num_nupdates_per_epoch = num_nupdates_per_epoch;
 }
 
-template<class Solver>
-void train_lr(const CommandLineArgsReader &args) {
+// Trains a logistic regression model on the given examples and returns the
+// optimization trace. If stream is given, examples hold the current window
+// of the stream and feature_counts are the counts over all windows. If
+// num_classes is not zero, labels are class ids and one-vs-rest models of
+// all classes are trained together (see MulticlassLogisticRegressionOracle).
+template<class Solver, class Examples>
+typename Solver::Solution solve_lr(
+    const CommandLineArgsReader &args,
+    const typename Solver::Options &options, const Examples *examples,
+    const std::vector<double> *labels, int num_features,
+    const Examples *test_examples, const std::vector<double> *test_labels,
+    ExampleStream *stream = 0, const std::vector<int> *feature_counts = 0,
+    int num_classes = 0) {
   typedef typename Solver::ParamVector ParamVector;
-  typedef typename Solver::Options Options;
   typedef typename Solver::Solution Solution;
 
   double l2_reg = atof(args.getParam("--l2_reg", "0.0").c_str());
-  bool normalize_examples = static_cast<bool>(
-      args.getParam("--normalize_examples", "1").c_str());
+  int batch_size = atoi(args.getParam("--batch", "0").c_str());
+  //ASSERT(batch_size > 0, "Invalid batch size");
+
+  std::unique_ptr<Solver> solver(new Solver(options));
+  solver->setExampleStream(stream);
+  Solution solution;
+
+  if(num_classes == 0 && batch_size == 0) {
+    // Binary models are solved with statically dispatched oracle calls.
+    LogisticRegressionOracle<ParamVector, Examples> oracle(
+        examples, labels, num_features, l2_reg, test_examples, test_labels,
+        feature_counts);
+    solution = solver->solveWith(&oracle);
+  } else {
+    Oracle<ParamVector, typename Solver::Gradient> *oracle;
+
+    if(num_classes > 0) {
+      oracle = new MulticlassLogisticRegressionOracle<ParamVector, Examples>(
+          examples, labels, num_features, num_classes, l2_reg, test_examples,
+          test_labels, feature_counts);
+    } else {
+      oracle = new LogisticRegressionOracle<ParamVector, Examples>(
+          examples, labels, num_features, l2_reg, test_examples,
+          test_labels, feature_counts);
+    }
+
+    if(batch_size > 0) {
+      ASSERT(stream == 0, "--batch is not supported with --stream");
+      oracle = new BatchOracle<ParamVector>(oracle, true, batch_size);
+    }
+
+    solution = solver->solve(oracle);
+    delete oracle;
+  }
+
+  if(HugePages::mode() != HugePageMode::NONE) {LOG(HugePages::report());}
+  return solution;
+}
+
+template<class Solution>
+void printSolution(const Solution &solution) {
+  std::cout << "Time: " << solution.timems << std::endl;
+  std::cout << "Objective: " << solution.objective << std::endl;
+  std::cout << "Trace:" << std::endl;
+
+  std::cout << "epoch\ttime(ms)\tobj\tgrad_sq_norm\ttest_error" << std::endl;
+  for(auto t : solution.trace) {
+    std::cout << t.other_info["epoch"] << "\t" << t.timems <<
+        "\t" << t.objective << "\t" << t.grad_sq_norm;
+    std::cout << "\t" << t.other_info["test_error"] << std::endl;
+  }
+}
+
+template<class Solver>
+void printOptions(const CommandLineArgsReader &args,
+                  const typename Solver::Options &options) {
+  options.print(std::cout);
+  std::cout << "L2 Reg: " << atof(args.getParam("--l2_reg", "0.0").c_str())
+            << std::endl;
+  std::cout << "Threads: " << Platform::getNumLocalThreads() << std::endl;
+}
+
+// Trains a logistic regression model on the given examples and prints
+// the optimization trace (see solve_lr).
+template<class Solver, class Examples>
+void train_lr(const CommandLineArgsReader &args, const Examples *examples,
+              const std::vector<double> *labels, int num_features,
+              const Examples *test_examples,
+              const std::vector<double> *test_labels,
+              ExampleStream *stream = 0,
+              const std::vector<int> *feature_counts = 0,
+              int num_classes = 0) {
+  LOG("# Train Examples: "
+      << (stream == 0 ?(int64_t) examples->size() :stream->numExamples()));
+  LOG("# Test Examples:" << (test_examples == 0 ?0 :test_examples->size()));
+
+  typename Solver::Options options;
+  fillOptions<Solver>(args, &options);
+  printOptions<Solver>(args, options);
+
+  printSolution(solve_lr<Solver>(args, options, examples, labels,
+                                 num_features, test_examples, test_labels,
+                                 stream, feature_counts, num_classes));
+}
+
+// k-fold cross-validation on loaded examples. The training and test sets of
+// each fold are views of the examples (see IndexedDataset), so examples are
+// neither reloaded nor copied. With --cv_parallel=1, folds are trained
+// concurrently with one thread each, otherwise one after another with all
+// threads. Traces are printed in fold order, followed by the averages of the
+// final objective and test error.
+template<class Solver>
+void train_lr_cv(const CommandLineArgsReader &args,
+                 const CSRDataset &examples, int num_folds,
+                 int num_classes = 0) {
+  typedef IndexedDataset<CSRDataset> FoldDataset;
+  bool parallel_folds = static_cast<bool>(
+      atoi(args.getParam("--cv_parallel", "0").c_str()));
+  unsigned seed = atoi(args.getParam("--cv_seed", "1").c_str());
+  ASSERT(num_folds <= (int) examples.size(), "Too many folds");
+
+  typename Solver::Options options;
+  fillOptions<Solver>(args, &options);
+  printOptions<Solver>(args, options);
+  std::cout << "Folds: " << num_folds << std::endl;
+#ifndef USE_OPENMP
+  if(parallel_folds) {LOG("--cv_parallel has no effect without OpenMP");}
+#endif
+
+  std::vector<std::vector<int>> folds = crossValidationFolds(
+      examples.size(), num_folds, seed);
+  std::vector<typename Solver::Solution> solutions(num_folds);
+
+  #pragma omp parallel for schedule(dynamic, 1) if(parallel_folds)
+  for(int f = 0; f < num_folds; ++f) {
+    FoldDataset train(&examples, complementOfFold(examples.size(), folds[f]));
+    FoldDataset test(&examples, folds[f]);
+    LOG("Fold " << f << ": " << train.size() << " training and "
+        << test.size() << " test examples");
+
+    solutions[f] = solve_lr<Solver>(args, options, &train, &train.labels(),
+                                    examples.num_features(), &test,
+                                    &test.labels(), 0, 0, num_classes);
+  }
+
+  double objective = 0.0, test_error = 0.0;
+
+  for(int f = 0; f < num_folds; ++f) {
+    std::cout << "Fold: " << f << std::endl;
+    printSolution(solutions[f]);
+    objective += solutions[f].objective / num_folds;
+    test_error += solutions[f].trace.back().other_info["test_error"]
+        / num_folds;
+  }
+
+  std::cout << "CV Objective: " << objective << std::endl;
+  std::cout << "CV Test Error: " << test_error << std::endl;
+}
+
+// Whether examples are scaled to unit L2 norm (--normalize_examples), in
+// every training mode.
+bool normalizeExamples(const CommandLineArgsReader &args) {
+  return static_cast<bool>(
+      atoi(args.getParam("--normalize_examples", "1").c_str()));
+}
+
+// Returns the statistics in the sidecar of a data file (see DatasetStats)
+// if --use_stats is set and there is a valid sidecar, otherwise returns 0.
+std::unique_ptr<DatasetStats> loadStats(const CommandLineArgsReader &args,
+                                        const std::string &file_name) {
+  bool use_stats = static_cast<bool>(
+      atoi(args.getParam("--use_stats", "1").c_str()));
+  std::unique_ptr<DatasetStats> stats(new DatasetStats);
+
+  if(!use_stats || file_name == "" || !stats->load(file_name)) {
+    return std::unique_ptr<DatasetStats>();
+  }
+
+  LOG("Using statistics in " << DatasetStats::sidecarName(file_name));
+  return stats;
+}
+
+// Trains on examples accessed in place from memory mapped binary files.
+template<class Solver, class MappedDataset>
+void train_lr_mapped(const CommandLineArgsReader &args) {
+  bool normalize_examples = normalizeExamples(args);
+  std::string training_file = args.getParam("--train_file", "");
+  std::string test_file = args.getParam("--test_file", "");
+  bool split_train_test = static_cast<bool>(
+      atoi(args.getParam("--split_train_test", "0").c_str()));
+  ASSERT(!split_train_test, "--split_train_test is not supported with --mmap");
+  ASSERT(args.getParam("--reorder", "none") == "none",
+         "--reorder is not supported with --mmap, use bin/opt/reorder");
+  ASSERT(atoi(args.getParam("--cv_folds", "0").c_str()) <= 1,
+         "--cv_folds is not supported with --mmap");
+  ASSERT(atoi(args.getParam("--multiclass", "0").c_str()) == 0,
+         "--multiclass is not supported with --mmap");
+
+  MappedDataset examples;
+  MappedDataset test_examples;
+  MappedDataset *test_examples_ptr = 0;
+  const std::vector<double> *test_labels_ptr = 0;
+
+  std::unique_ptr<DatasetStats> stats = loadStats(args, training_file);
+  std::unique_ptr<DatasetStats> test_stats = loadStats(args, test_file);
+
+  bool open_train = examples.open(training_file, normalize_examples,
+                                  stats ?&stats->norms() :0);
+  ASSERT(open_train, "Could not read file" << training_file);
+
+  if(test_file != "") {
+    bool open_test = test_examples.open(test_file, normalize_examples,
+                                        test_stats ?&test_stats->norms() :0);
+    ASSERT(open_test, "Could not read file" << test_file);
+    ASSERT(examples.num_features() == test_examples.num_features(),
+           "Incompatible train and test files");
+    test_examples_ptr = &test_examples;
+    test_labels_ptr = &test_examples.labels();
+  }
+
+  train_lr<Solver>(args, &examples, &examples.labels(),
+                   examples.num_features(), test_examples_ptr,
+                   test_labels_ptr, 0, stats ?&stats->feature_counts() :0);
+}
+
+template<class Solver>
+void train_lr_mapped(const CommandLineArgsReader &args) {
+  std::string training_file = args.getParam("--train_file", "");
+
+  if(BinaryFileV2::isV2File(training_file)) {
+    train_lr_mapped<Solver, MappedBinaryV2Dataset>(args);
+  } else {
+    train_lr_mapped<Solver, MappedBinaryDataset>(args);
+  }
+}
+
+// Trains on a file that is read window by window in every epoch.
+template<class Solver>
+void train_lr_streaming(const CommandLineArgsReader &args) {
+  bool normalize_examples = normalizeExamples(args);
+  std::string training_file = args.getParam("--train_file", "");
+  std::string test_file = args.getParam("--test_file", "");
+  bool split_train_test = static_cast<bool>(
+      atoi(args.getParam("--split_train_test", "0").c_str()));
+  ASSERT(!split_train_test, "--split_train_test is not supported with --stream");
+  ASSERT(args.getParam("--reorder", "none") == "none",
+         "--reorder is not supported with --stream, use bin/opt/reorder");
+  ASSERT(atoi(args.getParam("--cv_folds", "0").c_str()) <= 1,
+         "--cv_folds is not supported with --stream");
+  ASSERT(atoi(args.getParam("--multiclass", "0").c_str()) == 0,
+         "--multiclass is not supported with --stream");
+  size_t window_mb = atoi(args.getParam(
+      "--stream_window_mb",
+      std::to_string(StreamingDataset::DEFAULT_WINDOW_BYTES >> 20)).c_str());
+  ASSERT(window_mb > 0, "Invalid --stream_window_mb");
+
+  std::unique_ptr<DatasetStats> stats = loadStats(args, training_file);
+  std::unique_ptr<DatasetStats> test_stats = loadStats(args, test_file);
+
+  StreamingDataset examples(training_file, normalize_examples,
+                            window_mb << 20, stats.get());
+  bool open_train = examples.open();
+  ASSERT(open_train, "Could not read file" << training_file);
+
+  CSRDataset test_examples;
+  CSRDataset *test_examples_ptr = 0;
+  const std::vector<double> *test_labels_ptr = 0;
+
+  if(test_file != "") {
+    BinaryDataReader::readTrainingFile(
+        test_file.c_str(), normalize_examples, test_examples,
+        test_stats ?&test_stats->norms() :0);
+    ASSERT(examples.num_features() == test_examples.num_features(),
+           "Incompatible train and test files");
+    test_examples_ptr = &test_examples;
+    test_labels_ptr = &test_examples.labels();
+  }
+
+  train_lr<Solver>(args, &examples.window(), &examples.window().labels(),
+                   examples.num_features(), test_examples_ptr,
+                   test_labels_ptr, &examples, &examples.feature_counts());
+}
+
+template<class Solver>
+void train_lr(const CommandLineArgsReader &args) {
+  bool normalize_examples = normalizeExamples(args);
   std::string training_file = args.getParam("--train_file", "");
   std::string test_file = args.getParam("--test_file", "");
   bool split_train_test = static_cast<bool>(
       atoi(args.getParam("--split_train_test", "0").c_str()));
   ASSERT(test_file == "" || !split_train_test, "");
+  int cv_folds = atoi(args.getParam("--cv_folds", "0").c_str());
+  ASSERT(cv_folds <= 1 || (test_file == "" && !split_train_test),
+         "--cv_folds cannot be combined with --test_file or --split_train_test");
+  bool multiclass = static_cast<bool>(
+      atoi(args.getParam("--multiclass", "0").c_str()));
 
-  int batch_size = atoi(args.getParam("--batch", "0").c_str());
-  //ASSERT(batch_size > 0, "Invalid batch size");
-  
-  int num_features, num_test_features;
-  std::vector<SparseVec> examples;
-  std::vector<double> labels;
-  std::vector<SparseVec> test_examples;
-  std::vector<SparseVec> *test_examples_ptr = 0;
-  std::vector<double> test_labels;
-  std::vector<double> *test_labels_ptr = 0;
+  CSRDataset examples;
+  CSRDataset test_examples;
+  CSRDataset *test_examples_ptr = 0;
+  const std::vector<double> *test_labels_ptr = 0;
+
+  std::unique_ptr<DatasetStats> stats = loadStats(args, training_file);
+  std::unique_ptr<DatasetStats> test_stats = loadStats(args, test_file);
 
   BinaryDataReader::readTrainingFile(
-      training_file.c_str(), normalize_examples, examples, labels,
-      num_features);
+      training_file.c_str(), normalize_examples, examples,
+      stats ?&stats->norms() :0, multiclass);
 
   if(test_file != "") {
     BinaryDataReader::readTrainingFile(
-        test_file.c_str(), normalize_examples, test_examples, test_labels,
-        num_test_features);
-    ASSERT(num_features == num_test_features,
+        test_file.c_str(), normalize_examples, test_examples,
+        test_stats ?&test_stats->norms() :0, multiclass);
+    ASSERT(examples.num_features() == test_examples.num_features(),
            "Incompatible train and test files");
     test_examples_ptr = &test_examples;
-    test_labels_ptr = &test_labels;
+    test_labels_ptr = &test_examples.labels();
   } else if(split_train_test) {
     std::default_random_engine r(0);
     std::uniform_int_distribution<int> u(1, 100);
 
-    int end = examples.size()-1; int idx = 0;
+    std::vector<int> train_ids(examples.size());
+    std::vector<int> test_ids;
+    for(size_t i = 0; i < train_ids.size(); ++i) {train_ids[i] = i;}
+
+    int end = train_ids.size()-1; int idx = 0;
     while(idx < end) {
       int p = u(r);
       if (p <= 20) {
-	test_examples.push_back(examples[idx]);
-	test_labels.push_back(labels[idx]);
-	examples[idx] = examples[end];
-	labels[idx] = labels[end];
+	test_ids.push_back(train_ids[idx]);
+	train_ids[idx] = train_ids[end];
 	--end;
       } else {++idx;}
     }
 
-    examples.erase(examples.begin()+end, examples.end());
-    labels.erase(labels.begin()+end, labels.end());
+    train_ids.erase(train_ids.begin()+end, train_ids.end());
+
+    test_examples = examples.select(test_ids);
+    examples = examples.select(train_ids);
+    // Feature counts of the file do not apply to the split.
+    stats.reset();
 
     test_examples_ptr = &test_examples;
-    test_labels_ptr = &test_labels;
+    test_labels_ptr = &test_examples.labels();
   }
 
-  LOG("# Train Examples: " << examples.size());
-  LOG("# Test Examples:" << test_examples.size());
-  
-  Oracle<ParamVector, SparseVec> *oracle = new
-      LogisticRegressionOracle<ParamVector>(
-          &examples, &labels, num_features, l2_reg, test_examples_ptr,
-          test_labels_ptr);
+  std::string reorder = args.getParam("--reorder", "none");
+  if(reorder != "none") {
+    LOG("Line reuse before reordering: " << ExampleOrder::lineReuse(examples));
+    examples = examples.select(ExampleOrder::byMethod(reorder, examples));
+    LOG("Line reuse after reordering: " << ExampleOrder::lineReuse(examples));
+  }
 
-  if(batch_size > 0) {
-    oracle = new BatchOracle<ParamVector>(oracle, true, batch_size);
+  // With --multiclass, each distinct training label is a class.
+  int num_classes = 0;
+  if(multiclass) {
+    std::vector<double> classes = distinctLabels(examples.labels());
+    toClassIds(classes, examples.mutable_labels());
+    toClassIds(classes, test_examples.mutable_labels());
+    num_classes = classes.size();
+    std::cout << "Classes: " << num_classes << std::endl;
   }
- 
-  Options options;
-  fillOptions<Solver>(args, &options);
-  
-  options.print(std::cout);
-  std::cout << "L2 Reg: " << l2_reg << std::endl;
-  std::cout << "Threads: " << Platform::getNumLocalThreads() << std::endl;
 
-  std::unique_ptr<Solver> solver(new Solver(options));
-  Solution solution = solver->solve(oracle);
-  
-  std::cout << "Time: " << solution.timems << std::endl;
-  std::cout << "Objective: " << solution.objective << std::endl;
-  std::cout << "Trace:" << std::endl;
+  if(NumaMode::fromString(args.getParam("--numa", "NONE")) != NumaMode::NONE) {
+    examples.placeOnNumaNodes(Platform::getNumLocalThreads());
+  }
 
-  std::cout << "epoch\ttime(ms)\tobj\tgrad_sq_norm\ttest_error" << std::endl;
-  for(auto &t : solution.trace) {
-    std::cout << t.other_info["epoch"] << "\t" << t.timems <<
-        "\t" << t.objective << "\t" << t.grad_sq_norm;
-    std::cout << "\t" << t.other_info["test_error"] << std::endl;
+  if(cv_folds > 1) {
+    train_lr_cv<Solver>(args, examples, cv_folds, num_classes);
+    return;
   }
 
-  delete oracle;
+  train_lr<Solver>(args, &examples, &examples.labels(),
+                   examples.num_features(), test_examples_ptr,
+                   test_labels_ptr, 0, stats ?&stats->feature_counts() :0,
+                   num_classes);
+}
+
+template<class Solver>
+void train_lr(const CommandLineArgsReader &args, bool use_mmap,
+              bool use_stream) {
+  if(use_mmap) {train_lr_mapped<Solver>(args);}
+  else if(use_stream) {train_lr_streaming<Solver>(args);}
+  else {train_lr<Solver>(args);}
 }
 
 int main(int argc, const char **argv) {
@@ -145,6 +445,17 @@ int main(int argc, const char **argv) {
   int num_threads = atoi(args.getParam("--num_threads", "1").c_str());  
   if(num_threads > 0) {Platform::setNumLocalThreads(num_threads);}
   
+  // Training files are read by a background thread into a ring of buffers.
+  int prefetch_depth = atoi(args.getParam(
+      "--prefetch_depth",
+      std::to_string(BinaryDataReader::DEFAULT_PREFETCH_DEPTH)).c_str());
+  size_t prefetch_buffer_mb = atoi(args.getParam(
+      "--prefetch_buffer_mb",
+      std::to_string(BinaryDataReader::DEFAULT_PREFETCH_BUFFER_SIZE >> 20))
+      .c_str());
+  BinaryDataReader::setDefaultPrefetch(prefetch_depth,
+                                       prefetch_buffer_mb << 20);
+
   std::string log_tag = args.getParam("--log_tag", "");
   SET_LOG_TAG(log_tag);
     
@@ -153,14 +464,44 @@ int main(int argc, const char **argv) {
   std::string solver = args.getParam("--solver", "svrg").c_str();
 
   std::cout << "Using " << solver << " Algorithm" << std::endl;
+
+  bool use_mmap = static_cast<bool>(
+      atoi(args.getParam("--mmap", "0").c_str()));
+  
+  bool use_stream = static_cast<bool>(
+      atoi(args.getParam("--stream", "0").c_str()));
+  ASSERT(!(use_mmap && use_stream), "--mmap and --stream are exclusive");
   
+  // Parameters and gradients are stored as double or float.
+  std::string precision = args.getParam("--precision", "double");
+  ASSERT(precision == "double" || precision == "float", "Invalid precision");
+  bool use_float = (precision == "float");
+  LOG("Using " << precision << " parameters");
+
+  // Backing of parameter vectors and loaded examples.
+  HugePages::setMode(HugePageMode::fromString(
+      args.getParam("--huge_pages", "NONE")));
+
+  // Instruction set of the sparse kernels; the best supported by default.
+  std::string simd = args.getParam("--simd", "AUTO");
+  if(simd != "AUTO") {SparseKernels::setIsa(SimdIsa::fromString(simd));}
+  LOG("Using " << SparseKernels::isa().toString() << " sparse kernels");
+
   if(solver == "sgd") {
-    train_lr<SGDSolver>(args);
+    if(use_float) {
+      train_lr<BasicSGDSolver<float>>(args, use_mmap, use_stream);
+    } else {
+      train_lr<SGDSolver>(args, use_mmap, use_stream);
+    }
   } else if(solver == "svrg") {
-    train_lr<SVRGSolver>(args);
+    if(use_float) {
+      train_lr<BasicSVRGSolver<float>>(args, use_mmap, use_stream);
+    } else {
+      train_lr<SVRGSolver>(args, use_mmap, use_stream);
+    }
   } else {
     ASSERT(false, "Invalid Sovler");
-  }  
+  }
 }
 
 
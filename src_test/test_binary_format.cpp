@@ -0,0 +1,317 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+#include "AsyncFileWriter.h"
+#include "BinaryDataWriter.h"
+#include "DatasetStats.h"
+#include "FeatureMap.h"
+#include "DataReader.h"
+#include "MappedDataset.h"
+
+using namespace std;
+
+// Random examples with a few empty ones and labels in {-1, 1}.
+CSRDataset generateExamples(int num_examples, int num_features) {
+  mt19937 rng(1);
+  uniform_int_distribution<int> num_nonzero_dist(0, 20);
+  uniform_real_distribution<float> value_dist(-1.0, 1.0);
+
+  CSRDataset examples;
+  for(int i = 0; i < num_examples; ++i) {
+    SparseVec example;
+    int index = 0;
+    for(int j = num_nonzero_dist(rng); j > 0; --j) {
+      index += 1 + rng() % (num_features / 20);
+      example.addElement(index, value_dist(rng));
+    }
+    examples.addExample(example, (rng() % 2) ?1.0 :-1.0);
+  }
+
+  return examples;
+}
+
+// Values may differ by at most 'tolerance' (lossy value encodings).
+template<class Dataset>
+void checkSameExamples(const CSRDataset &expected, const Dataset &actual,
+                       double tolerance = 0.0) {
+  ASSERT(expected.size() == actual.size(), "Wrong number of examples");
+
+  for(size_t i = 0; i < expected.size(); ++i) {
+    ASSERT((expected.labels()[i] > 0) == (actual.labels()[i] > 0),
+           "Wrong label " << i);
+    VectorIterator<CSRRowView> e(expected[i]);
+    VectorIterator<typename Dataset::value_type> a(actual[i]);
+
+    for(; e; e.next(), a.next()) {
+      ASSERT(a, "Missing features in example " << i);
+      ASSERT(e.index() == a.index() && fabs(e.value() - a.value()) <= tolerance,
+             "Wrong feature in example " << i);
+    }
+    ASSERT(!a, "Extra features in example " << i);
+  }
+}
+
+void testRoundTrip(int version, int examples_per_block, uint32_t flags = 0,
+                   double tolerance = 0.0) {
+  const int num_examples = 1000;
+  CSRDataset examples = generateExamples(num_examples, 1000);
+  string file_name = "/tmp/test_binary_format_" + to_string(getpid());
+
+  BinaryDataWriter writer(file_name, version, examples_per_block, flags);
+  ASSERT(writer.open(), "Could not open " << file_name);
+  writer.write(examples);
+  writer.close();
+
+  CSRDataset loaded;
+  BinaryDataReader::readTrainingFile(file_name.c_str(), false, loaded);
+  ASSERT(loaded.num_features() == writer.num_features(), "Wrong features");
+  checkSameExamples(examples, loaded, tolerance);
+
+  // Sequential and random access reads.
+  BinaryDataReader reader(file_name);
+  ASSERT(reader.init(), "Could not read " << file_name);
+  ASSERT(reader.version() == version, "Wrong version");
+  SparseExample example;
+  int count = 0;
+  while(reader.read(&example)) {++count;}
+  ASSERT(count == num_examples, "Wrong number of examples read");
+
+  // Prefetching with buffers smaller than most examples.
+  reader.setPrefetch(3, 100);
+  ASSERT(reader.init(), "Could not read " << file_name);
+  CSRDataset prefetched;
+  while(reader.read(&example)) {prefetched.addExample(example.feats, example.label);}
+  checkSameExamples(examples, prefetched, tolerance);
+
+  if(flags != 0) {
+    // Compressed files cannot be memory mapped.
+  } else if(version == 2) {
+    const int seek_example = (examples_per_block + 3) % num_examples;
+    reader.seek(seek_example);
+    ASSERT(reader.read(&example), "Could not read after seek");
+    ASSERT(example.feats.size() == examples[seek_example].size(),
+           "Wrong example after seek");
+
+    MappedBinaryV2Dataset mapped;
+    ASSERT(mapped.open(file_name, false), "Could not map " << file_name);
+    checkSameExamples(examples, mapped);
+  } else {
+    MappedBinaryDataset mapped;
+    ASSERT(mapped.open(file_name, false), "Could not map " << file_name);
+    checkSameExamples(examples, mapped);
+  }
+
+  reader.close();
+  remove(file_name.c_str());
+}
+
+string readFile(const string &file_name) {
+  FILE *file = fopen(file_name.c_str(), "rb");
+  ASSERT(file != 0, "Could not open " << file_name);
+  string contents;
+  char buffer[4096];
+  for(size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    contents.append(buffer, n);
+  }
+  fclose(file);
+  return contents;
+}
+
+// Writing datasets in parallel blocks gives the same file as writing their
+// examples one by one, whatever the chunk boundaries.
+void testChunkedWrite(int version, int examples_per_block,
+                      uint32_t flags = 0) {
+  const int num_examples = 1000;
+  CSRDataset examples = generateExamples(num_examples, 1000);
+  string prefix = "/tmp/test_chunked_write_" + to_string(getpid());
+
+  BinaryDataWriter expected_writer(prefix + "_expected", version,
+                                   examples_per_block, flags);
+  ASSERT(expected_writer.open(), "Could not open " << prefix);
+  for(size_t i = 0; i < examples.size(); ++i) {
+    expected_writer.write(examples[i], examples.labels()[i]);
+  }
+  expected_writer.close();
+
+  // Chunks of 0 to 300 examples, and single examples in between.
+  mt19937 rng(2);
+  BinaryDataWriter writer(prefix, version, examples_per_block, flags);
+  ASSERT(writer.open(), "Could not open " << prefix);
+  for(int i = 0; i < num_examples;) {
+    if(rng() % 4 == 0) {
+      writer.write(examples[i], examples.labels()[i]);
+      ++i;
+      continue;
+    }
+
+    vector<CSRDataset> chunks(rng() % 4);
+    for(CSRDataset &chunk : chunks) {
+      for(int n = rng() % 100; n > 0 && i < num_examples; --n, ++i) {
+        chunk.addExample(examples[i], examples.labels()[i]);
+      }
+    }
+    writer.write(chunks);
+  }
+  writer.close();
+
+  ASSERT(writer.num_examples() == num_examples, "Wrong number of examples");
+  ASSERT(readFile(prefix) == readFile(prefix + "_expected"),
+         "Chunked write of version " << version << " differs");
+  remove(prefix.c_str());
+  remove((prefix + "_expected").c_str());
+}
+
+// Half precision conversions must round trip and round to nearest even.
+void testHalfConversions() {
+  for(uint32_t h = 0; h < 0x10000; ++h) {
+    float value = halfToFloat(h);
+    if(std::isnan(value)) {continue;}
+    ASSERT(floatToHalf(value) == h, "Half " << h << " does not round trip");
+  }
+
+  ASSERT(floatToHalf(1.0f) == 0x3c00, "Wrong half for 1");
+  ASSERT(floatToHalf(-2.0f) == 0xc000, "Wrong half for -2");
+  ASSERT(floatToHalf(65504.0f) == 0x7bff, "Wrong largest half");
+  ASSERT(floatToHalf(65520.0f) == 0x7c00, "65520 must round to infinity");
+  ASSERT(floatToHalf(1.0f + 1.0f / 2048) == 0x3c00, "Tie must round to even");
+  ASSERT(floatToHalf(1.0f + 3.0f / 2048) == 0x3c02, "Tie must round to even");
+  ASSERT(floatToHalf(5.96046448e-08f) == 0x0001, "Wrong smallest subnormal");
+  ASSERT(std::isnan(halfToFloat(floatToHalf(NAN))), "NaN must stay NaN");
+}
+
+// Large deltas need several varint bytes.
+void testVarintIndices() {
+  vector<int32_t> indices = {0, 1, 127, 128, 16384, 2000000000, 5, 6};
+  vector<int64_t> row_offsets = {0, 6, 6, 8};
+  vector<char> encoded;
+  binV2EncodeIndices(BIN_V2_VARINT_INDICES, indices.data(), row_offsets.data(),
+                     3, &encoded);
+
+  vector<int32_t> decoded(indices.size());
+  binV2DecodeIndices(BIN_V2_VARINT_INDICES, encoded.data(), encoded.size(),
+                     row_offsets.data(), 3, decoded.data());
+  ASSERT(decoded == indices, "Wrong varint indices");
+}
+
+// Appends larger and smaller than the writer buffers, and a header update.
+void testAsyncFileWriter() {
+  string file_name = "/tmp/test_async_writer_" + to_string(getpid());
+  string expected;
+  AsyncFileWriter writer(64, 2);
+  ASSERT(writer.open(file_name), "Could not open " << file_name);
+
+  for(int size : {8, 1, 63, 64, 65, 1000, 3}) {
+    string data(size, 'a' + size % 26);
+    writer.write(data.data(), data.size());
+    expected += data;
+  }
+  writer.writeAt("header", 6, 0);
+  expected.replace(0, 6, "header");
+  ASSERT(writer.size() == (int64_t) expected.size(), "Wrong size");
+  writer.close();
+
+  FILE *file = fopen(file_name.c_str(), "rb");
+  string actual(expected.size() + 1, 0);
+  actual.resize(fread(&actual[0], 1, actual.size(), file));
+  fclose(file);
+  remove(file_name.c_str());
+  ASSERT(actual == expected, "Wrong file contents");
+}
+
+// Statistics must match a direct computation and be rejected once the data
+// file changes.
+void testDatasetStats() {
+  CSRDataset examples = generateExamples(1000, 1000);
+  string file_name = "/tmp/test_dataset_stats_" + to_string(getpid());
+  string stats_name = DatasetStats::sidecarName(file_name);
+
+  BinaryDataWriter writer(file_name, 2, 64);
+  ASSERT(writer.open(), "Could not open " << file_name);
+  writer.write(examples);
+  writer.close();
+
+  DatasetStats stats;
+  ASSERT(stats.compute(file_name), "Could not compute statistics");
+  ASSERT(stats.write(stats_name), "Could not write statistics");
+  DatasetStats loaded;
+  ASSERT(loaded.load(file_name), "Could not load statistics");
+  ASSERT(loaded.norms() == stats.norms()
+         && loaded.feature_counts() == stats.feature_counts(),
+         "Wrong loaded statistics");
+
+  CSRDataset normalized, from_norms;
+  BinaryDataReader::readTrainingFile(file_name.c_str(), true, normalized);
+  BinaryDataReader::readTrainingFile(file_name.c_str(), true, from_norms,
+                                     &loaded.norms());
+  checkSameExamples(normalized, from_norms);
+
+  vector<int> feature_counts(writer.num_features());
+  for(size_t i = 0; i < examples.size(); ++i) {
+    for(VectorIterator<CSRRowView> it(examples[i]); it; it.next()) {
+      ++feature_counts[it.index()];
+    }
+  }
+  ASSERT(feature_counts == loaded.feature_counts(), "Wrong feature counts");
+
+  BinaryDataWriter other_writer(file_name, 2, 128);
+  ASSERT(other_writer.open(), "Could not open " << file_name);
+  other_writer.write(examples);
+  other_writer.close();
+  ASSERT(!loaded.load(file_name), "Statistics of a changed file were loaded");
+
+  remove(file_name.c_str());
+  remove(stats_name.c_str());
+}
+
+// Frequent features come first, rare ones are dropped and examples stay
+// sorted by feature index.
+void testFeatureMap() {
+  FeatureMap map = FeatureMap::byFrequency({5, 0, 9, 1, 5, 7}, 2);
+  ASSERT(map.num_features() == 4, "Wrong number of features");
+  const int expected[] = {2, -1, 0, -1, 3, 1, -1};
+  for(int i = 0; i < 7; ++i) {
+    ASSERT(map.newIndex(i) == expected[i], "Wrong new index of " << i);
+  }
+
+  SparseVec example, remapped;
+  for(int i = 0; i < 6; ++i) {example.addElement(i, i);}
+  map.apply(example, &remapped);
+  VectorIterator<SparseVec> iterator(remapped);
+  for(int i : {2, 5, 0, 4}) {
+    ASSERT(iterator && iterator.value() == i, "Wrong remapped feature");
+    iterator.next();
+  }
+  ASSERT(!iterator, "Dropped features were kept");
+
+  string file_name = "/tmp/test_feature_map_" + to_string(getpid());
+  ASSERT(map.write(file_name), "Could not write " << file_name);
+  FeatureMap loaded;
+  ASSERT(loaded.read(file_name), "Could not read " << file_name);
+  remove(file_name.c_str());
+  for(int i = 0; i < 7; ++i) {
+    ASSERT(loaded.newIndex(i) == expected[i], "Wrong loaded index of " << i);
+  }
+}
+
+int main() {
+  testAsyncFileWriter();
+  testHalfConversions();
+  testVarintIndices();
+  testRoundTrip(1, 64);
+  testRoundTrip(2, 64);
+  testRoundTrip(2, 1024);
+  testRoundTrip(2, 64, BIN_V2_VARINT_INDICES);
+  testRoundTrip(2, 64, BIN_V2_VARINT_INDICES | BIN_V2_FLOAT16_VALUES, 5e-4);
+  testRoundTrip(2, 1024, BIN_V2_UINT8_VALUES, 1.0 / 255 + 1e-6);
+  testChunkedWrite(1, 64);
+  testChunkedWrite(2, 64);
+  testChunkedWrite(2, 16, BIN_V2_VARINT_INDICES | BIN_V2_FLOAT16_VALUES);
+  testDatasetStats();
+  testFeatureMap();
+  cout << "OK" << endl;
+  return 0;
+}
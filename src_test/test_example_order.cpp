@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "CSRDataset.h"
+#include "ExampleOrder.h"
+
+using namespace std;
+
+// Examples drawn from clusters of features spread over a large index range,
+// in random order.
+CSRDataset generateClusteredExamples(int num_examples, int num_clusters) {
+  const int num_features = 1000000;
+  mt19937 rng(1);
+  vector<vector<int>> clusters(num_clusters);
+
+  for(vector<int> &cluster : clusters) {
+    for(int j = 0; j < 100; ++j) {cluster.push_back(rng() % num_features);}
+  }
+
+  CSRDataset examples;
+  examples.set_num_features(num_features);
+
+  for(int i = 0; i < num_examples; ++i) {
+    vector<int> features = clusters[rng() % num_clusters];
+    shuffle(features.begin(), features.end(), rng);
+    features.resize(20);
+    sort(features.begin(), features.end());
+    features.erase(unique(features.begin(), features.end()), features.end());
+
+    SparseVec example;
+    for(int f : features) {example.addElement(f, 1.0 + rng() % 10);}
+    examples.addExample(example, i % 2);
+  }
+
+  return examples;
+}
+
+void checkOrder(const CSRDataset &examples, const vector<int> &order,
+                double min_reuse) {
+  vector<int> sorted_order(order);
+  sort(sorted_order.begin(), sorted_order.end());
+  for(size_t i = 0; i < sorted_order.size(); ++i) {
+    ASSERT(sorted_order[i] == (int) i, "Order is not a permutation");
+  }
+
+  double reuse = ExampleOrder::lineReuse(examples.select(order));
+  ASSERT(reuse >= min_reuse, "Low line reuse " << reuse);
+}
+
+int main() {
+  CSRDataset examples = generateClusteredExamples(20000, 500);
+  double reuse = ExampleOrder::lineReuse(examples);
+
+  checkOrder(examples, ExampleOrder::byDominantFeature(examples), 2 * reuse);
+  checkOrder(examples, ExampleOrder::byMinHash(examples), 4 * reuse);
+
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include <vector>
+
+#include "CSRDataset.h"
+#include "IndexedDataset.h"
+
+using namespace std;
+
+// Folds partition the examples and views return the selected examples.
+int main() {
+  CSRDataset examples;
+  examples.set_num_features(100);
+  for(int i = 0; i < 103; ++i) {
+    SparseVec example;
+    example.addElement(i % 100, i);
+    examples.addExample(example, i % 3);
+  }
+
+  const int num_folds = 5;
+  vector<vector<int>> folds = crossValidationFolds(examples.size(), num_folds, 1);
+  vector<int> fold_of(examples.size(), -1);
+
+  for(int f = 0; f < num_folds; ++f) {
+    ASSERT(folds[f].size() == 20 || folds[f].size() == 21, "Unbalanced folds");
+    for(int i : folds[f]) {
+      ASSERT(fold_of[i] == -1, "Example " << i << " is in two folds");
+      fold_of[i] = f;
+    }
+
+    IndexedDataset<CSRDataset> train(
+        &examples, complementOfFold(examples.size(), folds[f]));
+    IndexedDataset<CSRDataset> test(&examples, folds[f]);
+    ASSERT(train.size() + test.size() == examples.size(), "Wrong fold sizes");
+    ASSERT(train.num_features() == 100, "Wrong number of features");
+
+    for(size_t i = 0; i < test.size(); ++i) {
+      VectorIterator<CSRRowView> iterator(test[i]);
+      ASSERT(iterator.value() == folds[f][i], "Wrong test example");
+      ASSERT(test.labels()[i] == folds[f][i] % 3, "Wrong test label");
+    }
+
+    for(size_t i = 0; i < train.size(); ++i) {
+      VectorIterator<CSRRowView> iterator(train[i]);
+      ASSERT(fold_of[(int) iterator.value()] != f,
+             "Test example in training set");
+    }
+  }
+
+  for(int f : fold_of) {ASSERT(f >= 0, "Example in no fold");}
+
+  cout << "OK" << endl;
+  return 0;
+}
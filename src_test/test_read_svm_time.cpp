@@ -1,219 +1,166 @@
+// Measures the throughput (MB/s) of reading LIBSVM text.
+// Usage: test_read_svm_time [svm_file]
+// If no file is given, a synthetic file is generated in /tmp and removed
+// afterwards.
+
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <cstring>
+#include <random>
+#include <string>
 
-#include<unistd.h>
-#include<fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Platform.h"
 #include "DataReader.h"
+#include "TextParsing.h"
 
 using namespace std;
 
-const char *file_name = "/home/ahefny/data/url_combined";
+const size_t SYNTHETIC_FILE_SIZE = 64 * 1024 * 1024;
 
-int g_num_tokens = 0;
-double g_sum = 0.0;
+string generateFile() {
+  char file_name[] = "/tmp/svrg_svm_benchmark_XXXXXX";
+  int fd = mkstemp(file_name);
+  ASSERT(fd >= 0, "Could not create temporary file");
+  FILE *file = fdopen(fd, "w");
 
-char *readDouble(char *buffer, size_t size, char delim, double *value) {
-	int whole = 0; int frac = 0; int denom = 1;
-	const char *end = buffer + size;
+  std::default_random_engine r(0);
+  std::uniform_int_distribution<int> num_nonzero(5, 100);
+  std::uniform_int_distribution<int> gap(1, 1000);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
 
-	while(buffer < end && *buffer != delim && *buffer != '.') {
-		whole = whole * 10 + (*(buffer++) - '0');
-	} 
+  size_t size = 0;
+  while(size < SYNTHETIC_FILE_SIZE) {
+    size += fprintf(file, "%s", (r() % 2) ?"+1" :"-1");
+    int n = num_nonzero(r);
+    int index = 0;
 
-	while(buffer < end && *buffer != delim) {
-		//assert(*buffer != 'e');
-		//assert(*buffer != 'E');
-		frac = frac * 10 + (*(buffer++) - '0');
-		denom *= 10;
-	} 
+    for(int i = 0; i < n; ++i) {
+      index += gap(r);
+      size += fprintf(file, " %d:%.6g", index, value(r));
+    }
 
-	*value = whole + frac / (double) denom;
+    size += fprintf(file, "\n");
+  }
 
-	if(buffer == end) {return nullptr;}
-	else {return buffer+1;}
+  fclose(file);
+  return file_name;
 }
 
-void processToken(char *token, size_t size, 
-						 int *index, double *value) {
-	token[size] = 0;
-	char*end = token + size;
-	++g_num_tokens;
-
-	int idx = 0;
-	
-	while(*token != ':') idx = (idx)*10 + (*(token++) - '0');
-
-	*index = idx;
-	*value = atof(token+1);
-	//readDouble(token+1, end-token-1, ' ', value);
-	g_sum += *value;
+double fileSizeMB(const string &file_name) {
+  struct stat file_stat;
+  stat(file_name.c_str(), &file_stat);
+  return file_stat.st_size / (1024.0 * 1024.0);
 }
 
-void processLine(char *line, size_t size, int &num_lines) {
-	line[size] = 0;
-	char *end = line + size;
-
-	char *label_end = (char*) memchr(line, ' ', size);
-	*label_end = 0;
-	int label = atof(line);
-	++g_num_tokens;
-	
-	int index; double value;
-
-	char *last_p = label_end + 1;
-	char *p = last_p;
-	while((p = (char*) memchr(p+1, ' ', end-p-1)) != 0) {
-		// Process Token		
-		processToken(last_p, p-last_p, &index, &value);		
-		last_p = p+1;
-	}
-
-	processToken(last_p, end-last_p, &index, &value);		
-
-	++num_lines;
+void report(const char *name, double size_mb, const Platform::Time &start,
+            const Platform::Time &end, size_t count, const char *unit) {
+  double seconds = Platform::getDurationus(start, end) * 1e-6;
+  cout << name << ": " << count << " " << unit << " in " << seconds
+       << "s (" << size_mb / seconds << " MB/s)" << endl;
 }
 
-void processFileUnix() {
-	int fd = open(file_name, O_RDONLY);
-	posix_fadvise(fd, 0, 0, 1);  // FDADVICE_SEQUENTIAL
-
-	const size_t BUFFER_SIZE = 16 * 1024;
-	const size_t STASH_SIZE = 10000;	
-	static_assert(STASH_SIZE <= BUFFER_SIZE, "Invalid stash size");
-
-	char storage[BUFFER_SIZE + STASH_SIZE];
-	char * const stash = storage;
-	char * const buffer = storage + STASH_SIZE;
-	
-	int l = 0;
-
-	char *last_stash = buffer;
-	bool is_next_token_label = true;
-
-	int label;
-	int index;
-	double value;
-
-	while(ssize_t b = read(fd, buffer, BUFFER_SIZE)) {
-		char *p = buffer-1;
-		char *end = buffer + b;
-		char *last_p = last_stash;
-		
-		while((p = (char*) memchr(p+1, '\n', end-p-1)) != 0) {
-			
-			// process from last_p to p			
-			processLine(last_p, p-last_p, l);
-			//is_next_token_label = 
-			//	processToken(last_p, p-last_p, is_next_token_label, 
-			//				 &label, &index, &value);
-
-			last_p = p+1;			
-		}
-
-		const size_t stash_size = end-last_p;
-		last_stash = buffer - stash_size;
-		ASSERT(stash_size <= STASH_SIZE, "Insufficient stash size");
-		memcpy(last_stash, last_p, stash_size);
-	}
-
-	LOG(l);
-
-	close(fd);
+// Single threaded SVMDataReader, optionally with background prefetching.
+void benchmarkSequential(const string &file_name, double size_mb,
+                         int prefetch_depth) {
+  SVMDataReader reader(file_name);
+  reader.setPrefetch(prefetch_depth, SVMDataReader::DEFAULT_PREFETCH_BUFFER_SIZE);
+  bool open_input = reader.init();
+  ASSERT(open_input, "Could not open " << file_name);
+
+  SparseExample example;
+  size_t num_examples = 0;
+
+  Platform::Time start = Platform::getCurrentTime();
+  while(reader.read(&example)) {++num_examples;}
+  Platform::Time end = Platform::getCurrentTime();
+
+  reader.close();
+  string name = "SVMDataReader (prefetch depth " +
+      to_string(prefetch_depth) + ")";
+  report(name.c_str(), size_mb, start, end, num_examples, "examples");
 }
 
-void processFile() {	
-	ifstream in(file_name, ios::binary);
-  //TODO: Check file
-
-  double result = 0.0;
-
-  string line, token;
-  int linenum = 0;
-  int numFeatures = -1;
-
-  double label;
+// ParallelSVMDataReader using all threads.
+void benchmarkParallel(const string &file_name, double size_mb) {
+  ParallelSVMDataReader reader(file_name);
+  bool open_input = reader.init();
+  ASSERT(open_input, "Could not open " << file_name);
 
-  while(getline(in, line, '\n')) {
-    ++linenum;
-
-	//result += 1.0;
-
-    vector<string> tokens;
-    istringstream linestream(line);
-
-    while(getline(linestream, token, ' ')) {
-		++g_num_tokens;
-		//result += 1.0;
-		tokens.push_back(token);
-    }
+  std::vector<CSRDataset> chunks;
+  size_t num_examples = 0;
 
-	
-    label = atof(tokens[0].c_str());
-    if(label < 0.0) {label = 0.0;}
-
-    for(size_t i = 1; i < tokens.size(); ++i) {
-      size_t colon = tokens[i].find(':');
-      ASSERT(colon > 0, "line=" << linenum << " i=" << i << " token=" << tokens[i]);
-
-      char *str = const_cast<char *>(tokens[i].c_str());
-      str[colon] = 0;
-      int idx = atoi(str);
-      double val = atof(str + colon + 1);
-
-      if(idx > numFeatures) {numFeatures = idx;}
-
-	  result += label + idx + val;
-    }
-
-    //if(linenum % 1000 == 0) {LOG("Read " << linenum << " examples");}
+  Platform::Time start = Platform::getCurrentTime();
+  while(reader.read(&chunks)) {
+    for(const auto &chunk : chunks) {num_examples += chunk.size();}
   }
+  Platform::Time end = Platform::getCurrentTime();
 
-  LOG("# of features = " << linenum << " " << numFeatures << " " << result);
+  reader.close();
 
-  /*for(size_t i = 0; i < indices.size(); ++i) {
-    data.push_back(SparseVector<double>(numFeatures));
-    SparseVector<double> &newVector = data.back();
-
-    for(size_t j = 0; j < indices[i].size(); ++j) {
-      newVector.insert(indices[i][j]) = vals[i][j];
-    }
-	}*/
+  string name = "ParallelSVMDataReader (" +
+      to_string(Platform::getNumLocalThreads()) + " threads)";
+  report(name.c_str(), size_mb, start, end, num_examples, "examples");
 }
 
-void processFileObj() {
-	SVMDataReader reader(file_name);
-	reader.init();
-
-	SparseExample example;
-	example.feats.resize(1000000000);
-
-	int num_lines = 0;
-
-	while(reader.read(&example)) {
-		++num_lines;
+// Number parsing alone: TextParsing::parseDouble vs strtod.
+void benchmarkNumbers() {
+  const int num_numbers = 4000000;
+  std::default_random_engine r(0);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+  string text;
+  for(int i = 0; i < num_numbers; ++i) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6g ", value(r));
+    text += buffer;
+  }
 
-		//if(num_lines % 1000 == 0) {LOG(num_lines);}
-	}
+  double size_mb = text.size() / (1024.0 * 1024.0);
+  double sum = 0.0;
 
-	reader.close();
+  Platform::Time start = Platform::getCurrentTime();
+  const char *p = text.c_str();
+  for(int i = 0; i < num_numbers; ++i) {
+    char *end;
+    sum += strtod(p, &end);
+    p = end + 1;
+  }
+  Platform::Time end = Platform::getCurrentTime();
+  report("strtod", size_mb, start, end, num_numbers, "numbers");
+
+  start = Platform::getCurrentTime();
+  p = text.c_str();
+  DelimiterScanner scanner(p, text.c_str() + text.size());
+  for(int i = 0; i < num_numbers; ++i) {
+    const char *delimiter = scanner.next();
+    double x = 0.0;
+    TextParsing::parseDouble(p, delimiter, &x);
+    sum -= x;
+    p = delimiter + 1;
+  }
+  end = Platform::getCurrentTime();
+  report("DelimiterScanner + parseDouble", size_mb, start, end, num_numbers,
+         "numbers");
 
-	LOG(num_lines);
+  ASSERT(fabs(sum) < 1e-6, "Parsers disagree");
 }
 
-int main() {   
-	Platform::init();
-	Platform::setNumLocalThreads(1);
+int main(int argc, char **argv) {
+  Platform::init();
+
+  bool generated = (argc < 2);
+  string file_name = generated ?generateFile() :argv[1];
+  double size_mb = fileSizeMB(file_name);
+  cout << "File: " << file_name << " (" << size_mb << " MB)" << endl;
 
-	Platform::Time start = Platform::getCurrentTime();
-	processFileObj();
-	Platform::Time end = Platform::getCurrentTime();
+  benchmarkNumbers();
+  benchmarkSequential(file_name, size_mb, 0);
+  benchmarkSequential(file_name, size_mb, SVMDataReader::DEFAULT_PREFETCH_DEPTH);
+  benchmarkParallel(file_name, size_mb);
 
-	cout << "Time duration = " << Platform::getDurationms(start, end) << endl;
-	LOG(g_num_tokens);
-	
-	return 0;
+  if(generated) {unlink(file_name.c_str());}
+  return 0;
 }
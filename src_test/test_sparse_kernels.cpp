@@ -0,0 +1,108 @@
+// The SIMD sparse kernels agree with the scalar ones, including on the
+// tails of vectors whose size is not a multiple of the SIMD width.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "SparseKernels.h"
+
+using namespace std;
+
+const int DIMENSION = 4096;
+
+// Sizes below, at and above MIN_SIMD_SIZE, with every remainder modulo 4
+// and several modulo 8.
+const size_t SIZES[] = {0, 1, 7, 127, 128, 129, 130, 131, 134, 135, 136, 517,
+                        2051};
+
+vector<int32_t> randomIndices(size_t size, std::default_random_engine &r) {
+  vector<int32_t> indices(DIMENSION);
+  for(int k = 0; k < DIMENSION; ++k) {indices[k] = k;}
+  shuffle(indices.begin(), indices.end(), r);
+  indices.resize(size);
+  sort(indices.begin(), indices.end());
+  return indices;
+}
+
+template<class T>
+vector<T> randomValues(size_t size, std::default_random_engine &r) {
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  vector<T> values(size);
+  for(T &x : values) {x = value(r);}
+  return values;
+}
+
+template<int N, class Value, class Real>
+void checkDot(SimdIsa isa, const vector<int32_t> &indices,
+              const vector<Value> &values, const vector<vector<Real>> &dense) {
+  const Real *arrays[N];
+  for(int j = 0; j < N; ++j) {arrays[j] = dense[j].data();}
+  double expected[N], output[N];
+
+  SparseKernels::setIsa(SimdIsa::SCALAR);
+  SparseKernels::dot<N>(indices.data(), values.data(), indices.size(), 0.5,
+                        arrays, expected);
+  SparseKernels::setIsa(isa);
+  SparseKernels::dot<N>(indices.data(), values.data(), indices.size(), 0.5,
+                        arrays, output);
+
+  // Lane sums only change the rounding of dot products.
+  for(int j = 0; j < N; ++j) {
+    ASSERT(fabs(output[j] - expected[j]) <= 1e-12 * indices.size(),
+           isa.toString() << " dot<" << N << "> of size " << indices.size()
+           << ": " << output[j] << " instead of " << expected[j]);
+  }
+}
+
+template<class Value, class Real>
+void checkAxpy(SimdIsa isa, const vector<int32_t> &indices,
+               const vector<Value> &values, const vector<Real> &dense) {
+  vector<Real> expected = dense;
+  SparseKernels::setIsa(SimdIsa::SCALAR);
+  SparseKernels::axpy(indices.data(), values.data(), indices.size(), 0.5,
+                      -0.3, expected.data());
+
+  vector<Real> output = dense;
+  SparseKernels::setIsa(isa);
+  SparseKernels::axpy(indices.data(), values.data(), indices.size(), 0.5,
+                      -0.3, output.data());
+
+  ASSERT(output == expected,
+         isa.toString() << " axpy of size " << indices.size() << " differs");
+}
+
+template<class Value, class Real>
+void checkKernels(SimdIsa isa, std::default_random_engine &r) {
+  vector<vector<Real>> dense;
+  for(int j = 0; j < 3; ++j) {dense.push_back(randomValues<Real>(DIMENSION, r));}
+
+  for(size_t size : SIZES) {
+    vector<int32_t> indices = randomIndices(size, r);
+    vector<Value> values = randomValues<Value>(size, r);
+
+    checkDot<1>(isa, indices, values, dense);
+    checkDot<2>(isa, indices, values, dense);
+    checkDot<3>(isa, indices, values, dense);
+    checkAxpy(isa, indices, values, dense[0]);
+  }
+}
+
+int main() {
+  const SimdIsa best = SparseKernels::bestIsa();
+  std::default_random_engine r(0);
+
+  for(SimdIsa isa : {SimdIsa::AVX2, SimdIsa::AVX512}) {
+    if(isa > best) {continue;}
+    checkKernels<float, float>(isa, r);
+    checkKernels<float, double>(isa, r);
+    checkKernels<double, float>(isa, r);
+    checkKernels<double, double>(isa, r);
+  }
+
+  SparseKernels::setIsa(best);
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Measures the sparse kernels of SparseKernels with each instruction set the
+// CPU supports, for sparse vectors of several sizes (test_sparse_kernels
+// checks that they agree).
+// Usage: test_sparse_kernels_time [dimension] [nonzeros_per_trial]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Platform.h"
+#include "SparseKernels.h"
+
+using namespace std;
+
+const int NUM_NONZEROS[] = {8, 32, 128, 512, 2048};
+
+// Sparse vectors with sorted random indices, laid out one after the other
+// as in a CSRDataset.
+struct SparseVectors {
+  int num_nonzero;
+  vector<int32_t> indices;
+  vector<float> values;
+};
+
+SparseVectors generate(int num_nonzero, int dimension, size_t total_nonzero,
+                       std::default_random_engine &r) {
+  std::uniform_int_distribution<int32_t> index(0, dimension - 1);
+  std::uniform_real_distribution<float> value(-1.0, 1.0);
+
+  SparseVectors vectors;
+  vectors.num_nonzero = num_nonzero;
+  const size_t num_vectors = total_nonzero / num_nonzero;
+
+  for(size_t i = 0; i < num_vectors; ++i) {
+    vector<int32_t> vector_indices;
+    while((int) vector_indices.size() < num_nonzero) {
+      while((int) vector_indices.size() < num_nonzero) {
+        vector_indices.push_back(index(r));
+      }
+      sort(vector_indices.begin(), vector_indices.end());
+      vector_indices.erase(unique(vector_indices.begin(), vector_indices.end()),
+                           vector_indices.end());
+    }
+
+    for(int32_t k : vector_indices) {
+      vectors.indices.push_back(k);
+      vectors.values.push_back(value(r));
+    }
+  }
+
+  return vectors;
+}
+
+void report(const char *kernel, SimdIsa isa, const SparseVectors &vectors,
+            const Platform::Time &start, const Platform::Time &end) {
+  double ns = Platform::getDurationus(start, end) * 1e3
+      / vectors.indices.size();
+  cout << kernel << " " << isa.toString() << " nnz=" << vectors.num_nonzero
+       << ": " << ns << " ns per non-zero" << endl;
+}
+
+// Runs the dot product with N dense arrays over all vectors and returns the
+// sum of the results, so that the loop is not optimized away.
+template<int N, class Real>
+double benchmarkDot(const SparseVectors &vectors,
+                    const vector<vector<Real>> &dense, SimdIsa isa) {
+  SparseKernels::setIsa(isa);
+  const Real *arrays[N];
+  for(int j = 0; j < N; ++j) {arrays[j] = dense[j].data();}
+  const int n = vectors.num_nonzero;
+  double sum = 0.0;
+
+  Platform::Time start = Platform::getCurrentTime();
+  for(size_t k = 0; k < vectors.indices.size(); k += n) {
+    double output[N];
+    SparseKernels::dot<N>(vectors.indices.data() + k,
+                          vectors.values.data() + k, n, 0.5, arrays, output);
+    for(int j = 0; j < N; ++j) {sum += output[j];}
+  }
+  Platform::Time end = Platform::getCurrentTime();
+
+  report(N == 1 ?"dot" :"dot3", isa, vectors, start, end);
+  return sum;
+}
+
+template<class Real>
+void benchmarkAxpy(const SparseVectors &vectors, int dimension, SimdIsa isa) {
+  SparseKernels::setIsa(isa);
+  vector<Real> dense(dimension, 0.0);
+  const int n = vectors.num_nonzero;
+
+  Platform::Time start = Platform::getCurrentTime();
+  for(size_t k = 0; k < vectors.indices.size(); k += n) {
+    SparseKernels::axpy(vectors.indices.data() + k, vectors.values.data() + k,
+                        n, 0.5, -0.01, dense.data());
+  }
+  Platform::Time end = Platform::getCurrentTime();
+
+  report(sizeof(Real) == sizeof(float) ?"axpy (float)" :"axpy", isa, vectors,
+         start, end);
+}
+
+int main(int argc, char **argv) {
+  Platform::init();
+
+  int dimension = (argc > 1) ?atoi(argv[1]) :(1 << 22);
+  size_t total_nonzero = (argc > 2) ?atoll(argv[2]) :(1 << 20);
+  const SimdIsa best = SparseKernels::bestIsa();
+  cout << "Dimension: " << dimension << ", best instruction set: "
+       << best.toString() << endl;
+
+  std::default_random_engine r(0);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  vector<vector<double>> dense(3, vector<double>(dimension));
+  for(auto &array : dense) {
+    for(double &x : array) {x = value(r);}
+  }
+
+  vector<SimdIsa> isas = {SimdIsa::SCALAR};
+  if(best >= SimdIsa::AVX2) {isas.push_back(SimdIsa::AVX2);}
+  if(best >= SimdIsa::AVX512) {isas.push_back(SimdIsa::AVX512);}
+
+  double sum = 0.0;
+  for(int num_nonzero : NUM_NONZEROS) {
+    SparseVectors vectors = generate(num_nonzero, dimension, total_nonzero, r);
+
+    for(SimdIsa isa : isas) {
+      sum += benchmarkDot<1>(vectors, dense, isa);
+      sum += benchmarkDot<3>(vectors, dense, isa);
+      benchmarkAxpy<double>(vectors, dimension, isa);
+      benchmarkAxpy<float>(vectors, dimension, isa);
+    }
+  }
+  cout << "Sum of dot products: " << sum << endl;
+
+  SparseKernels::setIsa(best);
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "DataReader.h"
+#include "TextFormatting.h"
+#include "TextParsing.h"
+
+using namespace std;
+
+// Checks that parseDouble agrees bit for bit with strtod.
+void checkDouble(const char *str) {
+  double expected = strtod(str, 0);
+  double value = 0.0;
+  bool valid = TextParsing::parseDouble(str, str + strlen(str), &value);
+
+  ASSERT(valid, "Could not parse " << str);
+  ASSERT(memcmp(&value, &expected, sizeof(double)) == 0,
+         "Mismatch for " << str << ": " << value << " vs " << expected);
+}
+
+void checkInvalid(const char *str) {
+  double value;
+  bool valid = TextParsing::parseDouble(str, str + strlen(str), &value);
+  ASSERT(!valid, "Accepted invalid number " << str);
+}
+
+void testDoubles() {
+  const char *cases[] = {
+    "0", "-0", "+1", "-1", "1.5", ".5", "5.", "0.000123", "-0.000123",
+    "1e10", "1E-10", "-2.5e+3", "123456789012345678", "1234567890123456789",
+    "12345678901234567890123", "0.1234567890123456789012", "9007199254740993",
+    "1e22", "1e23", "1e-22", "1e-23", "4.9e-324", "1.7976931348623157e308",
+    "1e400", "1e-400", "inf", "-inf", "00000.00001", "3.14159265358979323846"};
+
+  for(const char *c : cases) {checkDouble(c);}
+
+  checkInvalid("");
+  checkInvalid("-");
+  checkInvalid("1e");
+  checkInvalid("1.2.3");
+  checkInvalid("1x");
+
+  std::default_random_engine r(0);
+  std::uniform_real_distribution<double> mantissa(-10.0, 10.0);
+  std::uniform_int_distribution<int> exponent(-30, 30);
+  std::uniform_int_distribution<int> precision(1, 17);
+  char buffer[64];
+
+  for(int i = 0; i < 1000000; ++i) {
+    double x = mantissa(r) * pow(10.0, exponent(r));
+    const char *format = (i % 3 == 0) ?"%.*g" :(i % 3 == 1) ?"%.*e" :"%.*f";
+    snprintf(buffer, sizeof(buffer), format, precision(r), x);
+    checkDouble(buffer);
+  }
+}
+
+void testLines() {
+  SparseExample example;
+  string line = "-1 3:0.5\t10:-2e-3  17:4 \r";
+  SVMDataReader::parseLine(line.data(), line.data() + line.size(), &example);
+
+  ASSERT(example.label == -1, "Wrong label");
+  ASSERT(example.feats.size() == 3, "Wrong number of features");
+
+  VectorIterator<SparseVec> iterator(example.feats);
+  ASSERT(iterator.index() == 3 && iterator.value() == 0.5, "Wrong feature");
+  iterator.next();
+  ASSERT(iterator.index() == 10 && iterator.value() == -2e-3, "Wrong feature");
+  iterator.next();
+  ASSERT(iterator.index() == 17 && iterator.value() == 4, "Wrong feature");
+
+  // Long lines are scanned across several blocks.
+  line = "+1";
+  for(int i = 1; i <= 1000; ++i) {line += " " + to_string(i) + ":" + to_string(i);}
+  SVMDataReader::parseLine(line.data(), line.data() + line.size(), &example);
+  ASSERT(example.label == 1, "Wrong label");
+  ASSERT(example.feats.size() == 1000, "Wrong number of features");
+
+  line = "";
+  SVMDataReader::parseLine(line.data(), line.data(), &example);
+  ASSERT(example.label == 0 && example.feats.size() == 0, "Wrong empty line");
+}
+
+// Number of digits between the first and last non-zero digits.
+int significantDigits(const char *str) {
+  string digits;
+  for(const char *c = str; *c && *c != 'e'; ++c) {
+    if((*c >= '1' && *c <= '9') || (*c == '0' && !digits.empty())) {digits += *c;}
+  }
+  return digits.find_last_not_of('0') + 1;
+}
+
+// Checks that formatFloat reads back as the same float, with no more
+// digits than the shortest %g representation that does.
+void checkFloat(float value) {
+  char buffer[TextFormatting::MAX_FLOAT_LENGTH + 1];
+  *TextFormatting::formatFloat(value, buffer) = 0;
+  float parsed = strtof(buffer, 0);
+  ASSERT(memcmp(&parsed, &value, sizeof(float)) == 0,
+         "Float " << value << " formatted as " << buffer);
+
+  char expected[TextFormatting::MAX_FLOAT_LENGTH];
+  for(int precision = 1; precision <= 9; ++precision) {
+    snprintf(expected, sizeof(expected), "%.*e", precision - 1, value);
+    if(strtof(expected, 0) == value) {break;}
+  }
+  ASSERT(significantDigits(buffer) <= significantDigits(expected),
+         "Float " << value << " formatted as " << buffer << " vs " << expected);
+}
+
+void testFormatting() {
+  char buffer[TextFormatting::MAX_FLOAT_LENGTH + 1];
+  const struct {float value; const char *str;} cases[] = {
+    {0.0f, "0"}, {-0.0f, "-0"}, {1.0f, "1"}, {-2.5f, "-2.5"}, {0.1f, "0.1"},
+    {100.0f, "100"}, {123456.0f, "123456"}, {0.000123f, "0.000123"},
+    {1e-5f, "0.00001"}, {1e-6f, "1e-6"}, {1e15f, "1000000000000000"}, {1e16f, "1e16"},
+    {3.14159274f, "3.1415927"}, {16777216.0f, "16777216"},
+    {3.4028235e38f, "3.4028235e38"}, {1.4e-45f, "1e-45"}, {INFINITY, "inf"}};
+
+  for(const auto &c : cases) {
+    *TextFormatting::formatFloat(c.value, buffer) = 0;
+    ASSERT(strcmp(buffer, c.str) == 0,
+           "Float " << c.value << " formatted as " << buffer);
+  }
+
+  const int64_t ints[] = {0, 7, -7, 10, 99, 100, -12345, 2147483647,
+                          -9223372036854775807LL - 1};
+  for(int64_t i : ints) {
+    *TextFormatting::formatInt(i, buffer) = 0;
+    ASSERT(buffer == to_string(i), "Integer " << i << " formatted as " << buffer);
+  }
+
+  // Random bit patterns cover all exponents, including subnormals.
+  std::default_random_engine r(0);
+  for(int i = 0; i < 300000; ++i) {
+    uint32_t bits = r();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    if(!std::isnan(value)) {checkFloat(value);}
+  }
+
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  for(int i = 0; i < 300000; ++i) {checkFloat(uniform(r));}
+}
+
+int main() {
+  testDoubles();
+  testLines();
+  testFormatting();
+  cout << "OK" << endl;
+  return 0;
+}